@@ -34,80 +34,167 @@
 
 #include <sys/param.h>
 #include <sys/types.h>
+#include <poll.h>
 #include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
 #include <errno.h>
 
 #include <GL/gl.h>
 #include <GL/glext.h>
 #include <GL/glu.h>
 
-#include <ft2build.h>
-#include FT_FREETYPE_H
-
 #include "glxwindow.h"
+#include "glutils.h"
+#include "glstate.h"
+#include "prng.h"
+#include "flame.h"
+#include "gltexstream.h"
+#include "flame_gl.h"
+#include "facecache.h"
+#include "cubemesh.h"
+#include "facesdf.h"
+#include "facegeom.h"
+#include "spheremesh.h"
+#include "framesched.h"
+#include "monoclock.h"
+#include "glyphs.h"
+#include "digits_baked.h"
 
 #ifndef __unused
 #	define __unused		__attribute__((__unused__))
 #endif
+#ifndef nitems
+#	define nitems(__val)	(sizeof(__val) / sizeof(__val[0]))
+#endif
 
 
 #define CUBES_COUNT		3
 
-#define FONT_HEIGHT		256
+#define FONT_HEIGHT		GLYPHS_FONT_HEIGHT
 
 #define BITMAP_WIDTH		512
 #define BITMAP_HEIGHT		512
 
-#define FLAME_WIDTH		1024
-#define FLAME_HEIGHT		1024
-
-#define CUBE_ROTATION_SPEED	0.006f
-
-#define FONT_NAME		"./fonts/Roboto-Bold.ttf"
-
+/* Degrees per second. */
+#define CUBE_ROTATION_SPEED	6.0f
+#define CUBE_SWING_SPEED	12.0f
+#define CUBE_SWING_MAX		60.0f
+
+/* Fixed simulation clock: cubes and flame advance by ticks, frames are
+ * drawn with cubes state interpolated between last two ticks. */
+#define SIM_TICK_RATE_DEF	60
+#define SIM_TICK_RATE_MAX	1000
+/* Ticks run per frame at most, clock skips rest after long stall. */
+#define SIM_TICKS_MAX		8
+
+#define FLAME_ENGINE_CPU	0
+#define FLAME_ENGINE_GPU	1
+
+/* CPU engine flame texture upload. */
+#define FLAME_UPLOAD_INDEX	0 /* Heat bytes, palette applied by GPU. */
+#define FLAME_UPLOAD_RGB	1 /* Palette applied by CPU. */
+
+/* Cube faces. */
+#define FACE_MODE_CACHE		0 /* Drawn once to textures, face cache. */
+#define FACE_MODE_SDF		1 /* Composed by shader, SDF glyphs. */
+#define FACE_MODE_DIRECT	2 /* Drawn to cube texture on change. */
+
+/* Flame quad at z = -10: x in [-FLAME_QUAD_X * aspect,
+ * FLAME_QUAD_X * aspect], y in [FLAME_QUAD_BOTTOM, FLAME_QUAD_TOP]. */
+#define FLAME_QUAD_X		5.0f
+#define FLAME_QUAD_BOTTOM	-5.2f
+#define FLAME_QUAD_TOP		4.0f
+#define FLAME_QUAD_Z		-10.0f
+/* Flame grid cells per quad unit: grid covers quad, no more. */
+#define FLAME_CELLS_PER_UNIT	55.65f
+
+#define STATS_INTERVAL_MS	5000
+
+/* Frames per second cap, vertical retraces per swap. */
+#define FRAME_FPS_DEF		60
+#define SWAP_INTERVAL_DEF	1
+
+static const float flame_color[] = { 1.0f, 1.0f, 1.0f, 0.9f };
 static const float light0Diffuse[] = { 1.0f, 1.0f, 1.0f, 1.0f };
 static const float light0Ambient[] = { 0.3f, 0.3f, 0.3f, 0.3f };
 static const float light0Direction[] = { 0.0f, 0.0f, 1.0f, 0.0f };
+/* Same lighting for shader drawn objects: light0Direction in eye space,
+ * default light model ambient 0.2 + light0Ambient. */
+static const float shader_light[] = { 0.0f, 0.0f, 1.0f, 0.5f };
 static const float cube_x[] = { -2.0f, 0.0f, 2.0f };
 static const float sphere_x[] = { 1.0f, 1.0f, -1.0f, -1.0f };
 static const float sphere_y[] = { 0.2f, -0.2f, 0.2f, -0.2f };
+static const float sphere_color[] = { 0.4f, 0.2f, 0.2f, 1.0f };
+#define SPHERE_RADIUS		0.1f
 static const float range_z = -5.5f;
 
 
-typedef struct rgb_s {
-	uint8_t		r;
-	uint8_t		g;
-	uint8_t		b;
-} rgb_t, *rgb_p;
-
 typedef struct digit_descriptor_s {
 	uint32_t	width;
 	uint32_t	height;
 	int32_t		top;
 	int32_t		left;
-	GLuint		texture;
+	uint32_t	tex_x;		/* Glyph rect in digits atlas. */
+	uint32_t	tex_y;
 } digit_desc_t, *digit_desc_p;
 
 typedef struct cube_s {
 	uint32_t	digit;
-	GLuint		texture;
+	GLuint		texture;	/* From face cache or own. */
 	float		x;
 	float		y;
-	float		d_y;
+	float		d_y;		/* angle_y change per second. */
 	float		angle_x;
 	float		angle_y;
+	float		prev_angle_x;	/* State of previous tick. */
+	float		prev_angle_y;
+	float		draw_angle_x;	/* Interpolated for frame. */
+	float		draw_angle_y;
 } cube_t, *cube_p;
 
 typedef struct cube_3d_clock_s {
 	volatile int	running;
-	rgb_t		flame_buf[FLAME_WIDTH][FLAME_HEIGHT];
+	int		flame_engine;	/* FLAME_ENGINE_*. */
+	flame_t		flame;
+	size_t		flame_width;	/* Current grid size. */
+	size_t		flame_height;
+	size_t		flame_threads;
+	int		flame_upload;	/* FLAME_UPLOAD_*. */
+	int		flame_pbo;	/* Stream via PBO, not directly. */
+	gl_tex_stream_t	flame_stream;	/* CPU engine output. */
+	size_t		flame_tex_rows;	/* Not zero rows in flame_stream. */
+	flame_gl_t	flame_gl;
 	digit_desc_t	digit_desc[10];
+	GLuint		digits_tex;	/* Alpha atlas with all glyphs. */
+	GLuint		face_bg_tex;	/* Face template: background, borders. */
+	const char	*font_name;	/* NULL: glyphs baked at build time. */
+	int		face_mode;	/* FACE_MODE_*. */
+	face_cache_t	face_cache;
+	size_t		face_cache_mem;	/* Memory cap, MB. */
+	face_sdf_t	face_sdf;
+	cube_mesh_t	cube_mesh;	/* SDF faces cubes geometry. */
 	cube_t		cubes[CUBES_COUNT];
 	int32_t		mpos_x;
 	int32_t		mpos_y;
-	GLuint		flame_tex;
-	uint64_t	prev_time_ms;
-	GLUquadricObj	*sphere_obj;
+	uint32_t	tick_rate;	/* Simulation ticks per second. */
+	uint64_t	tick_ns;	/* Tick duration. */
+	uint64_t	tick_time_ns;	/* Time of last tick. */
+	uint64_t	seed;		/* PRNG seed, -s or random. */
+	prng_t		prng;
+	int		stats;		/* Print stats to stderr. */
+	uint64_t	stats_time_ms;
+	uint64_t	stats_frames;	/* Frames drawn since last print. */
+	sphere_mesh_t	sphere_mesh;
+	size_t		sphere_detail;	/* Slices and stacks. */
+	uint32_t	glx_flags;	/* GLX_WND_F_*. */
+	uint32_t	fps;		/* Frames per second cap, 0: none. */
+	int		swap_interval;	/* Retraces per swap, 0: no vsync. */
+	frame_sched_t	frame_sched;
 	glx_wnd_t	glx_wnd;
 } c3d_clk_t, *c3d_clk_p;
 
@@ -115,191 +202,135 @@ typedef struct cube_3d_clock_s {
 
 static inline uint64_t
 get_millisec(void) {
-	struct timespec ts;
-
-	clock_gettime(CLOCK_MONOTONIC, &ts);
 
-	return ((uint64_t)((ts.tv_sec * 1000) + (ts.tv_nsec / 1000000)));
-}
-
-static inline void
-sleep_millisec(uint32_t ms) {
-	struct timespec	ts;
-
-	ts.tv_sec = (ms / 1000);
-	ts.tv_nsec = ((ms * 1000000) - (ts.tv_sec * 1000000000));
-	nanosleep(&ts, NULL);
+	return (monoclock_ns() / 1000000);
 }
 
 static inline uint32_t
-randval(uint32_t max_val) {
-	return (arc4random() % (max_val + 1));
+randval(c3d_clk_p c3d_clk, uint32_t max_val) {
+	return (prng_range(&c3d_clk->prng, max_val));
 }
 
-static void
-flame_update(c3d_clk_p c3d_clk) {
-	size_t i, j;
-	uint8_t tmp, color, pal_buf[FLAME_WIDTH][FLAME_HEIGHT];
-	static rgb_t palit[256];
-	static int palit_init_done = 0;
-
-	/* Filling flame palit. */
-	if (0 == palit_init_done) {
-		palit_init_done ++;
-		memset(&palit, 0x00, sizeof(palit));
-		for (i = 0; i < 64; i ++) {
-			palit[i +   0].r = (uint8_t)(i * 4);
-			palit[i +  64].r = 0xff;
-			palit[i +  64].g = (uint8_t)(i * 4);
-			palit[i + 128].r = 0xff;
-			palit[i + 128].g = 0xff;
-			palit[i + 128].b = (uint8_t)(i * 4);
-			palit[i + 192].r = 0xff;
-			palit[i + 192].g = 0xff;
-			palit[i + 192].b = 0xff;
-		}
-	}
+/* Generates digits atlas texture from glyphs baked at build time or
+ * from font_name: glyphs in one row, one pixel gap between them.
+ * In FACE_MODE_SDF also SDF atlas, mode falls back to FACE_MODE_CACHE
+ * if shaders not supported. */
+static int	
+create_digits_tex_array(c3d_clk_p c3d_clk) {
+	int error;
+	const glyph_bitmap_t *glyphs = digits_baked_glyphs;
+	glyph_bitmap_t glyphs_loaded[GLYPHS_COUNT];
+	const uint8_t *sdf = digits_baked_sdf, *bufs[GLYPHS_COUNT];
+	const face_sdf_glyph_t *sdf_glyphs = digits_baked_sdf_glyphs;
+	face_sdf_glyph_t sdf_glyphs_loaded[GLYPHS_COUNT];
+	uint8_t *glyphs_mem = NULL, *bitmap = NULL, *sdf_loaded = NULL;
+	size_t i, x, y, bm_width = 0, bm_height = 0;
+	size_t sdf_width = DIGITS_BAKED_SDF_WIDTH;
+	size_t sdf_height = DIGITS_BAKED_SDF_HEIGHT;
+	digit_desc_p digit;
 
-	/* Flame seeds. */
-	for (i = 0; i < FLAME_WIDTH; i += 8) {
-		color = (uint8_t)arc4random();
-		for (j = 0; j < 8; j ++) {
-			pal_buf[i + j][0] = color;
+	memset(&c3d_clk->digit_desc, 0x00, sizeof(c3d_clk->digit_desc));
+	c3d_clk->digits_tex = 0;
+
+	if (NULL != c3d_clk->font_name) {
+		error = glyphs_load(c3d_clk->font_name, glyphs_loaded,
+		    &glyphs_mem);
+		if (0 != error) {
+			fprintf(stderr, "Font %s load failed, "
+			    "using built in.\n", c3d_clk->font_name);
+		} else {
+			glyphs = glyphs_loaded;
 		}
 	}
 
-#if 0
-	/* One pass flame gen method. */
-	for (i = 1; i < (FLAME_WIDTH - 1); i ++) {
-		for (j = 1; j < (FLAME_HEIGHT - 1); j ++) {
-			tmp =(uint8_t)((
-			    pal_buf[i - 1][j - 1] +
-			    pal_buf[i][j - 1] +
-			    pal_buf[i + 1][j - 1] +
-			    pal_buf[i][j -1]) / 3.96f);
-			if (tmp > 1) {
-				tmp --;
-			} else {
-				tmp = 0;
-			}
-			pal_buf[i][j] = tmp;
-			c3d_clk->flame_buf[i][j] = palit[tmp];
-		}
+	/* Place glyphs. */
+	for (i = 0; i < nitems(c3d_clk->digit_desc); i ++) {
+		digit = &c3d_clk->digit_desc[i];
+		digit->width = glyphs[i].width;
+		digit->height = glyphs[i].height;
+		digit->top = glyphs[i].top;
+		digit->left = glyphs[i].left;
+		digit->tex_x = (uint32_t)bm_width;
+		digit->tex_y = 0;
+		bm_width += (digit->width + 1);
+		bm_height = MAX(bm_height, digit->height);
 	}
-#else
-	/* Two pass flame gen method. */
-	for (i = 1; i < (FLAME_WIDTH - 1); i ++) {
-		for (j = 1; j < (FLAME_HEIGHT - 1); j ++) {
-			tmp = (uint8_t)((pal_buf[i - 1][j - 1] +
-			    pal_buf[i][j - 1] +
-			    pal_buf[i + 1][j - 1]) / 2.97f);
-			if (tmp > 1) {
-				tmp --;
-			} else {
-				tmp = 0;
-			}
-			pal_buf[i][j] = tmp;
-		}
+
+	/* One byte for each pixel: alpha. */
+	bitmap = (uint8_t*)calloc(1, (bm_width * bm_height));
+	if (NULL == bitmap) {
+		error = ENOMEM;
+		goto err_out;
 	}
-	for (i = (FLAME_WIDTH - 2); i > 1; i --) {
-		for (j = 1; j < (FLAME_HEIGHT - 1); j ++) {
-			tmp = (uint8_t)((pal_buf[i - 1][j - 1] +
-			    pal_buf[i][j - 1] +
-			    pal_buf[i + 1][j - 1]) / 2.97f);
-			if (tmp > 1) {
-				tmp --;
-			} else {
-				tmp = 0;
+	for (i = 0; i < nitems(c3d_clk->digit_desc); i ++) {
+		digit = &c3d_clk->digit_desc[i];
+		for (y = 0; y < digit->height; y ++) {
+			for (x = 0; x < digit->width; x ++) {
+				bitmap[(digit->tex_x + x + (y * bm_width))] =
+				    (uint8_t)(0.97f * glyphs[i].buf[x + y * digit->width]);
 			}
-			pal_buf[i][j] = tmp;
-			c3d_clk->flame_buf[i][j] = palit[tmp];
 		}
 	}
-#endif
-	//for (i = 0; i < (FLAME_WIDTH * FLAME_HEIGHT); i ++) {
-	//	c3d_clk->flame_buf[0][i] = palit[pal_buf[0][i]];
-	//}
-}
-
-
-/* Generates digits textures from tt fonts. */
-static int	
-create_digits_tex_array(c3d_clk_p c3d_clk) {
-	int error = -1;
-	FT_Library lib = NULL;
-	FT_Face font = NULL;
-	FT_GlyphSlot gliph = NULL;
-	uint8_t *bitmap = NULL;
-	size_t i, x, y, bm_size;
-
-	memset(&c3d_clk->digit_desc, 0x00, sizeof(c3d_clk->digit_desc));
-
-	if (0 != FT_Init_FreeType(&lib))
-		return (-1);
-
-	if (0 != FT_New_Face(lib, FONT_NAME, 0, &font))
-		goto err_out;
-
-	if (0 != FT_Set_Char_Size(font, (FONT_HEIGHT << 6),
-	    (FONT_HEIGHT << 6), 96, 96))
-		goto err_out;
 
-	gliph = font->glyph;
-	for (i = 0; i < nitems(c3d_clk->digit_desc); i ++) {
-		if (0 != FT_Load_Char(font, ('0' + i), FT_LOAD_RENDER))
-			goto err_out;
-
-		c3d_clk->digit_desc[i].width = gliph->bitmap.width;
-		c3d_clk->digit_desc[i].height = gliph->bitmap.rows;
-		c3d_clk->digit_desc[i].top = gliph->bitmap_top;
-		c3d_clk->digit_desc[i].left = gliph->bitmap_left;
-
-		/* Two bytes for each pixel. */
-		bm_size = (2 * c3d_clk->digit_desc[i].width *
-		    c3d_clk->digit_desc[i].height);
-		bitmap = (uint8_t*)malloc(bm_size);
-		if (NULL == bitmap) {
+	/* Custom font field is baked here. */
+	if (FACE_MODE_SDF == c3d_clk->face_mode &&
+	    glyphs == glyphs_loaded) {
+		for (i = 0; i < GLYPHS_COUNT; i ++) {
+			sdf_glyphs_loaded[i].width = glyphs[i].width;
+			sdf_glyphs_loaded[i].height = glyphs[i].height;
+			sdf_glyphs_loaded[i].left = glyphs[i].left;
+			bufs[i] = glyphs[i].buf;
+		}
+		sdf_loaded = face_sdf_atlas_bake(bufs, sdf_glyphs_loaded,
+		    &sdf_width, &sdf_height);
+		if (NULL == sdf_loaded) {
 			error = ENOMEM;
 			goto err_out;
 		}
-		memset(bitmap, 0xff, bm_size);
-
-		/* Filling bitmap grey&alpha bytes. */
-		for (y = 0; y < c3d_clk->digit_desc[i].height; y ++) {
-			for (x = 0; x < c3d_clk->digit_desc[i].width; x ++) {
-				bitmap[2 * (x + y * gliph->bitmap.width) + 1] =
-				    (uint8_t)(0.97f * gliph->bitmap.buffer[x + y * gliph->bitmap.width]);
-			}
-		}
-
-		/* Creating symbol texture. */
-		glGenTextures(1, &c3d_clk->digit_desc[i].texture);
-		if (0 == c3d_clk->digit_desc[i].texture)
+		sdf = sdf_loaded;
+		sdf_glyphs = sdf_glyphs_loaded;
+	}
+	if (FACE_MODE_SDF == c3d_clk->face_mode &&
+	    0 != face_sdf_init(&c3d_clk->face_sdf, sdf, (GLsizei)sdf_width,
+	    (GLsizei)sdf_height, sdf_glyphs, BITMAP_WIDTH, BITMAP_HEIGHT,
+	    ((BITMAP_HEIGHT - FONT_HEIGHT) / 2))) {
+		if (GL_CAPS(CORE)) { /* Face cache is fixed function. */
+			fprintf(stderr, "SDF faces not supported, "
+			    "try -l.\n");
+			error = EOPNOTSUPP;
 			goto err_out;
-		glEnable(GL_TEXTURE_RECTANGLE);
-		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-		glBindTexture(GL_TEXTURE_RECTANGLE, c3d_clk->digit_desc[i].texture);
-		glTexParameterf(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameterf(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA, 
-		    (GLsizei)c3d_clk->digit_desc[i].width,
-		    (GLsizei)c3d_clk->digit_desc[i].height, 0,
-		    GL_LUMINANCE_ALPHA,	GL_UNSIGNED_BYTE, bitmap);
-
-		free(bitmap);
-		bitmap = NULL;
+		}
+		fprintf(stderr, "SDF faces not supported, "
+		    "using face cache.\n");
+		c3d_clk->face_mode = FACE_MODE_CACHE;
 	}
+
+	/* Creating atlas texture: faces are drawn from it. */
+	error = 0;
+	if (FACE_MODE_SDF == c3d_clk->face_mode)
+		goto err_out;
+	error = ENOMEM;
+	glGenTextures(1, &c3d_clk->digits_tex);
+	if (0 == c3d_clk->digits_tex)
+		goto err_out;
+	gl_state_enable(GL_TEXTURE_RECTANGLE);
+	gl_state_pixel_store(GL_UNPACK_ALIGNMENT, 1);
+	gl_state_bind_texture(GL_TEXTURE_RECTANGLE, c3d_clk->digits_tex);
+	glTexParameterf(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameterf(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_ALPHA8,
+	    (GLsizei)bm_width, (GLsizei)bm_height, 0,
+	    GL_ALPHA, GL_UNSIGNED_BYTE, bitmap);
 	error = 0;
 
 err_out:
 	if (0 != error) {
-		for (i = 0; i < nitems(c3d_clk->digit_desc); i ++) {
-			glDeleteTextures(1, &c3d_clk->digit_desc[i].texture);
-		}
+		gl_state_delete_textures(1, &c3d_clk->digits_tex);
+		c3d_clk->digits_tex = 0;
 	}
 	free(bitmap);
-	FT_Done_Face(font);
-	FT_Done_FreeType(lib);
+	free(sdf_loaded);
+	free(glyphs_mem);
 
 	return (error);
 }
@@ -307,47 +338,27 @@ err_out:
 static void
 destroy_digits_tex_array(c3d_clk_p c3d_clk)
 {
-	for (size_t i = 0; i < nitems(c3d_clk->digit_desc); i ++) {
-		glDeleteTextures(1, &c3d_clk->digit_desc[i].texture);
-	}
+
+	gl_state_delete_textures(1, &c3d_clk->digits_tex);
+	c3d_clk->digits_tex = 0;
+	gl_state_delete_textures(1, &c3d_clk->face_bg_tex);
+	c3d_clk->face_bg_tex = 0;
 	memset(&c3d_clk->digit_desc, 0x00, sizeof(c3d_clk->digit_desc));
+	face_sdf_destroy(&c3d_clk->face_sdf);
 }
 
 
-/* Draw textured quads. */
+/* Face template: background, borders and lines, same for all faces. */
 static void
-draw_time_edge_texture(c3d_clk_p c3d_clk, const uint32_t time_val,
-    const GLuint tex_id) {
-	size_t i;
-	uint32_t x;
-	uint8_t time_digits[2];
-	digit_desc_p digit;
-	const uint32_t y = ((BITMAP_HEIGHT - FONT_HEIGHT) / 2);
-	const float border_width = 20.0f;
-	const float line_width = 3.0f;
-	const float cathet = 90.0f;
-	const float line_const = 0.8f;
-
-	if (99 < time_val)
-		return;
-	time_digits[0] = (uint8_t)(time_val / 10);
-	time_digits[1] = (uint8_t)(time_val % 10);
-
-	glViewport(0, 0, BITMAP_WIDTH, BITMAP_HEIGHT);
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
-	glOrtho(0, BITMAP_WIDTH, 0, BITMAP_HEIGHT, 0, 20);
-	gluLookAt(0, 0, 1, 0, 0, 0, 0, 1, 0);
+draw_face_template(void) {
+	const float border_width = (float)FACE_BORDER_WIDTH;
+	const float line_width = (float)FACE_LINE_WIDTH;
+	const float cathet = (float)FACE_CATHET;
+	const float line_inset = (float)FACE_LINE_INSET;
 
-	glDisable(GL_TEXTURE_RECTANGLE);
-
-	glMatrixMode(GL_MODELVIEW);
-	glLoadIdentity();
-
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	glEnable(GL_DEPTH_TEST);
-	glDisable(GL_BLEND);
+	gl_state_disable(GL_TEXTURE_RECTANGLE);
+	gl_state_enable(GL_DEPTH_TEST);
+	gl_state_disable(GL_BLEND);
 
 	/******* Drawing base cube edge texture background ************/
 	/* Background quad. */
@@ -456,166 +467,502 @@ draw_time_edge_texture(c3d_clk_p c3d_clk, const uint32_t time_val,
 	glBegin(GL_LINE_LOOP);
 	{
 		glNormal3f(0.0f, 0.0f, 1.0f);
-		glVertex3f((cathet * line_const), border_width, 1.0f);
-		glVertex3f((BITMAP_WIDTH - 1 - cathet * line_const), border_width, 1.0f);
-		glVertex3f((BITMAP_WIDTH - 1 - border_width), (cathet * line_const), 1.0f);
-		glVertex3f((BITMAP_WIDTH - 1 - border_width), (BITMAP_HEIGHT - 1 - cathet * line_const), 1.0f);
-		glVertex3f((BITMAP_WIDTH - 1 - cathet * line_const), (BITMAP_HEIGHT - 1 - border_width), 1.0f);
-		glVertex3f((cathet * line_const), (BITMAP_HEIGHT - 1 - border_width), 1.0f);
-		glVertex3f(border_width, (BITMAP_HEIGHT - 1 - cathet * line_const), 1.0f);
-		glVertex3f(border_width, (cathet * line_const), 1.0f);
+		glVertex3f(line_inset, border_width, 1.0f);
+		glVertex3f((BITMAP_WIDTH - 1 - line_inset), border_width, 1.0f);
+		glVertex3f((BITMAP_WIDTH - 1 - border_width), line_inset, 1.0f);
+		glVertex3f((BITMAP_WIDTH - 1 - border_width), (BITMAP_HEIGHT - 1 - line_inset), 1.0f);
+		glVertex3f((BITMAP_WIDTH - 1 - line_inset), (BITMAP_HEIGHT - 1 - border_width), 1.0f);
+		glVertex3f(line_inset, (BITMAP_HEIGHT - 1 - border_width), 1.0f);
+		glVertex3f(border_width, (BITMAP_HEIGHT - 1 - line_inset), 1.0f);
+		glVertex3f(border_width, line_inset, 1.0f);
 	}
 	glEnd();
+}
+
+/* Draw textured quads: face cache callback. */
+static void
+draw_time_edge_texture(void *udata, const uint32_t time_val) {
+	c3d_clk_p c3d_clk = udata;
+	size_t i;
+	uint32_t x;
+	uint8_t time_digits[2];
+	digit_desc_p digit;
+	const uint32_t y = ((BITMAP_HEIGHT - FONT_HEIGHT) / 2);
+
+	if (99 < time_val)
+		return;
+	time_digits[0] = (uint8_t)(time_val / 10);
+	time_digits[1] = (uint8_t)(time_val % 10);
+
+	glViewport(0, 0, BITMAP_WIDTH, BITMAP_HEIGHT);
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	glOrtho(0, BITMAP_WIDTH, 0, BITMAP_HEIGHT, 0, 20);
+	gluLookAt(0, 0, 1, 0, 0, 0, 0, 1, 0);
+
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	if (0 == c3d_clk->face_bg_tex) {
+		/* Drawn once and copied: faces framebuffer has it now. */
+		draw_face_template();
+		glGenTextures(1, &c3d_clk->face_bg_tex);
+		gl_state_bind_texture(GL_TEXTURE_RECTANGLE,
+		    c3d_clk->face_bg_tex);
+		glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MIN_FILTER,
+		    GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MAG_FILTER,
+		    GL_NEAREST);
+		glCopyTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA8, 0, 0,
+		    BITMAP_WIDTH, BITMAP_HEIGHT, 0);
+	} else {
+		/* Texel to pixel copy of template by one quad. */
+		gl_state_disable(GL_LIGHTING);
+		gl_state_enable(GL_TEXTURE_RECTANGLE);
+		gl_state_disable(GL_DEPTH_TEST);
+		gl_state_disable(GL_BLEND);
+		glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+		gl_state_bind_texture(GL_TEXTURE_RECTANGLE,
+		    c3d_clk->face_bg_tex);
+		glBegin(GL_QUADS);
+		{
+			glTexCoord2f(0.0f, 0.0f);
+			glVertex3f(0.0f, 0.0f, 1.0f);
+			glTexCoord2f(BITMAP_WIDTH, 0.0f);
+			glVertex3f(BITMAP_WIDTH, 0.0f, 1.0f);
+			glTexCoord2f(BITMAP_WIDTH, BITMAP_HEIGHT);
+			glVertex3f(BITMAP_WIDTH, BITMAP_HEIGHT, 1.0f);
+			glTexCoord2f(0.0f, BITMAP_HEIGHT);
+			glVertex3f(0.0f, BITMAP_HEIGHT, 1.0f);
+		}
+		glEnd();
+	}
 
 	glColor4f(1.0f, 1.0f, 1.0f, 0.9f);
 
 	/* Draw gliph quads. */
 	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-	glDisable(GL_LIGHTING);
-	glEnable(GL_TEXTURE_RECTANGLE);
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-	glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
-	glEnable(GL_COLOR_MATERIAL);
-	glDisable(GL_DEPTH_TEST);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	gl_state_disable(GL_LIGHTING);
+	gl_state_enable(GL_TEXTURE_RECTANGLE);
+	gl_state_pixel_store(GL_UNPACK_ALIGNMENT, 1);
+	gl_state_color_material(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
+	gl_state_enable(GL_COLOR_MATERIAL);
+	gl_state_disable(GL_DEPTH_TEST);
+	gl_state_enable(GL_BLEND);
+	gl_state_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	glNormal3f(0.0f, 0.0f, 1.0f);
 
+	/* Both digits from atlas in one batch. */
 	digit = &c3d_clk->digit_desc[time_digits[0]];
 	x = ((BITMAP_WIDTH / 2) - (digit->width + (uint32_t)digit->left));
+	gl_state_bind_texture(GL_TEXTURE_RECTANGLE, c3d_clk->digits_tex);
+	glBegin(GL_QUADS);
 	for (i = 0; i < 2; i ++) {
 		digit = &c3d_clk->digit_desc[time_digits[i]];
-		glBindTexture(GL_TEXTURE_RECTANGLE, digit->texture);
 
-		glBegin(GL_QUADS);
-		{
-			glTexCoord2f(digit->width, 0.0f);
-			glVertex3f((x + digit->width),
-			    (y + digit->height), 0.5f);
+		glTexCoord2f((digit->tex_x + digit->width), digit->tex_y);
+		glVertex3f((x + digit->width), (y + digit->height), 0.5f);
 
-			glTexCoord2f(0.0f, 0.0f);
-			glVertex3f(x, (y + digit->height), 0.5f);
+		glTexCoord2f(digit->tex_x, digit->tex_y);
+		glVertex3f(x, (y + digit->height), 0.5f);
 
-			glTexCoord2f(0.0f, digit->height);
-			glVertex3f(x, y, 0.5f);
+		glTexCoord2f(digit->tex_x, (digit->tex_y + digit->height));
+		glVertex3f(x, y, 0.5f);
 
-			glTexCoord2f(digit->width, digit->height);
-			glVertex3f((x + digit->width), y, 0.5f);
-		}
-		glEnd();
+		glTexCoord2f((digit->tex_x + digit->width),
+		    (digit->tex_y + digit->height));
+		glVertex3f((x + digit->width), y, 0.5f);
 
 		x += (digit->width + (uint32_t)digit->left);
 	}
-
-	glEnable(GL_TEXTURE_RECTANGLE);
-	glBindTexture(GL_TEXTURE_RECTANGLE, tex_id);
-	glCopyTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA, 0, 0,
-	    BITMAP_WIDTH, BITMAP_HEIGHT, 0);
+	glEnd();
 }
 
 
 
 static int
-cube_init(cube_p cube, const float x, const float y, const float d_y) {
+cube_init(c3d_clk_p c3d_clk, cube_p cube, const float x, const float y,
+    const float d_y) {
 
 	if (NULL == cube)
 		return (EINVAL);
 
 	memset(cube, 0x00, sizeof(cube_t));
 	cube->digit = (~((uint32_t)0));
-	glGenTextures(1, &cube->texture);
 	cube->x = x;
 	cube->y = y;
 	cube->d_y = d_y;
 	/* Getting start random rotation angles for cubes. */
-	cube->angle_x = randval(360);
-	cube->angle_y = randval(60);
+	cube->angle_x = randval(c3d_clk, 360);
+	cube->angle_y = randval(c3d_clk, 60);
+	cube->prev_angle_x = cube->angle_x;
+	cube->prev_angle_y = cube->angle_y;
+	cube->draw_angle_x = cube->angle_x;
+	cube->draw_angle_y = cube->angle_y;
 
 	return (0);
 }
 
 static void
-cube_destroy(cube_p cube) {
+cube_destroy(c3d_clk_p c3d_clk, cube_p cube) {
 
 	if (NULL == cube)
 		return;
-	glDeleteTextures(1, &cube->texture);
+	if (FACE_MODE_CACHE == c3d_clk->face_mode) {
+		face_cache_put(&c3d_clk->face_cache, cube->digit);
+	}
+	if (FACE_MODE_DIRECT == c3d_clk->face_mode) {
+		gl_state_delete_textures(1, &cube->texture);
+	}
 	memset(cube, 0x00, sizeof(cube_t));
 }
 
 static int
-cube_update(c3d_clk_p c3d_clk, cube_p cube, const uint32_t time_val,
-    const float rotation_delta) {
+cube_update(c3d_clk_p c3d_clk, cube_p cube, const uint32_t time_val) {
 
 	if (NULL == cube)
 		return (EINVAL);
 
+	if (FACE_MODE_SDF == c3d_clk->face_mode) {
+		cube->digit = time_val; /* Shader draws it. */
+		return (0);
+	}
+	if (FACE_MODE_DIRECT == c3d_clk->face_mode) {
+		if (time_val == cube->digit)
+			return (0);
+		cube->digit = time_val;
+		if (0 == cube->texture) {
+			glGenTextures(1, &cube->texture);
+			gl_state_bind_texture(GL_TEXTURE_RECTANGLE,
+			    cube->texture);
+			glTexParameteri(GL_TEXTURE_RECTANGLE,
+			    GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_RECTANGLE,
+			    GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		}
+		draw_time_edge_texture(c3d_clk, time_val);
+		gl_state_bind_texture(GL_TEXTURE_RECTANGLE, cube->texture);
+		glCopyTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA8, 0, 0,
+		    BITMAP_WIDTH, BITMAP_HEIGHT, 0);
+		return (0);
+	}
 	if (time_val != cube->digit) {
+		face_cache_put(&c3d_clk->face_cache, cube->digit);
 		cube->digit = time_val;
-		draw_time_edge_texture(c3d_clk, time_val, cube->texture);
+		cube->texture = face_cache_get(&c3d_clk->face_cache,
+		    time_val);
 	}
 
-	cube->angle_x += rotation_delta;
+	return (0);
+}
+
+/* One simulation tick: dt seconds. */
+static void
+cube_tick(cube_p cube, const float dt) {
+
+	cube->prev_angle_x = cube->angle_x;
+	cube->prev_angle_y = cube->angle_y;
+	cube->angle_x += (CUBE_ROTATION_SPEED * dt);
 	if (cube->angle_x > 360.0f) {
-		cube->angle_x = 0.0f;
+		cube->angle_x -= 360.0f;
 	}
-	cube->angle_y += cube->d_y;
-	if (cube->angle_y > 60.0f || cube->angle_y < -60.0f) {
+	cube->angle_y += (cube->d_y * dt);
+	if (cube->angle_y > CUBE_SWING_MAX || cube->angle_y < -CUBE_SWING_MAX) {
 		cube->d_y = -cube->d_y;
 	}
+}
 
-	return (0);
+/* Sets draw angles to state between previous (alpha = 0) and last
+ * (alpha = 1) ticks. */
+static void
+cube_interpolate(cube_p cube, const float alpha) {
+	float delta;
+
+	delta = (cube->angle_x - cube->prev_angle_x);
+	if (delta < -180.0f) { /* Wrapped over 360. */
+		delta += 360.0f;
+	}
+	cube->draw_angle_x = (cube->prev_angle_x + (delta * alpha));
+	cube->draw_angle_y = (cube->prev_angle_y +
+	    ((cube->angle_y - cube->prev_angle_y) * alpha));
+}
+
+/* Runs simulation ticks due by now_ns.
+ * Returns ticks count, *alpha - part of next tick passed. */
+static size_t
+sim_clock_update(c3d_clk_p c3d_clk, const uint64_t now_ns, float *alpha) {
+	size_t ticks;
+
+	if (0 == c3d_clk->tick_time_ns) {
+		c3d_clk->tick_time_ns = now_ns;
+	}
+	ticks = (size_t)((now_ns - c3d_clk->tick_time_ns) / c3d_clk->tick_ns);
+	if (SIM_TICKS_MAX < ticks) { /* Stalled: do not catch up. */
+		c3d_clk->tick_time_ns = (now_ns - c3d_clk->tick_ns);
+		ticks = 1;
+	}
+	c3d_clk->tick_time_ns += (ticks * c3d_clk->tick_ns);
+	(*alpha) = ((float)(now_ns - c3d_clk->tick_time_ns) /
+	    (float)c3d_clk->tick_ns);
+
+	return (ticks);
+}
+
+/* Flame grid size: cells covering flame quad. */
+static void
+flame_size(const float aspect, size_t *width, size_t *height) {
+	float cells;
+
+	cells = ((2.0f * FLAME_QUAD_X * aspect * FLAME_CELLS_PER_UNIT) + 0.5f);
+	(*width) = MIN(MAX((size_t)cells, FLAME_SIZE_MIN), FLAME_SIZE_MAX);
+	cells = (((FLAME_QUAD_TOP - FLAME_QUAD_BOTTOM) *
+	    FLAME_CELLS_PER_UNIT) + 0.5f);
+	(*height) = MIN(MAX((size_t)cells, FLAME_SIZE_MIN), FLAME_SIZE_MAX);
+}
+
+static void
+flame_engine_stop(c3d_clk_p c3d_clk) {
+
+	gl_tex_stream_destroy(&c3d_clk->flame_stream);
+	flame_destroy(&c3d_clk->flame);
+	flame_gl_destroy(&c3d_clk->flame_gl);
+	c3d_clk->flame_width = 0;
+	c3d_clk->flame_height = 0;
+}
+
+/* Starts flame engine with width x height grid, falls back to CPU engine
+ * and RGB upload if GPU does not support them.
+ * Returns 0 on success. */
+static int
+flame_engine_start(c3d_clk_p c3d_clk, const size_t width,
+    const size_t height) {
+	int error;
+
+	c3d_clk->flame_width = width;
+	c3d_clk->flame_height = height;
+	c3d_clk->flame_tex_rows = height; /* First upload is full. */
+	if (FLAME_ENGINE_GPU == c3d_clk->flame_engine) {
+		if (0 == flame_gl_init(&c3d_clk->flame_gl, 1, width, height,
+		    prng_u32(&c3d_clk->prng)))
+			return (0);
+		fprintf(stderr, "GPU flame engine not supported, "
+		    "using CPU.\n");
+		c3d_clk->flame_engine = FLAME_ENGINE_CPU;
+	}
+	if (FLAME_UPLOAD_INDEX == c3d_clk->flame_upload &&
+	    0 != flame_gl_init(&c3d_clk->flame_gl, 0, width, height, 0)) {
+		if (GL_CAPS(CORE)) { /* RGB quad is fixed function. */
+			fprintf(stderr, "GPU palette not supported, "
+			    "try -l.\n");
+			return (EOPNOTSUPP);
+		}
+		fprintf(stderr, "GPU palette not supported, "
+		    "uploading RGB.\n");
+		c3d_clk->flame_upload = FLAME_UPLOAD_RGB;
+	}
+	error = flame_init(&c3d_clk->flame, width, height,
+	    c3d_clk->flame_threads, 0, prng_u32(&c3d_clk->prng));
+	if (0 != error)
+		return (error);
+	error = flame_producer_start(&c3d_clk->flame,
+	    ((FLAME_UPLOAD_INDEX == c3d_clk->flame_upload) ?
+	     FLAME_OUT_INDEX : FLAME_OUT_RGB));
+	if (0 != error)
+		return (error);
+
+	return (flame_gl_stream_init(&c3d_clk->flame_stream,
+	    &c3d_clk->flame, (0 == c3d_clk->flame_pbo)));
+}
+
+/* Prints and resets counters every STATS_INTERVAL_MS. */
+static void
+stats_print(c3d_clk_p c3d_clk, const uint64_t cur_time_ms) {
+	gl_tex_stream_p ts = &c3d_clk->flame_stream;
+	flame_p flame = &c3d_clk->flame;
+	face_cache_p fc = &c3d_clk->face_cache;
+	uint64_t cells, cells_skipped;
+
+	if (0 == c3d_clk->stats ||
+	    (cur_time_ms - c3d_clk->stats_time_ms) < STATS_INTERVAL_MS)
+		return;
+	fprintf(stderr, "frames: %"PRIu64" fps, %"PRIu64" deadlines missed.\n",
+	    ((c3d_clk->stats_frames * 1000) /
+	    (cur_time_ms - c3d_clk->stats_time_ms)),
+	    c3d_clk->frame_sched.missed);
+	c3d_clk->frame_sched.missed = 0;
+	c3d_clk->stats_time_ms = cur_time_ms;
+
+	if (0 != ts->upload_count) {
+		fprintf(stderr, "flame upload (%s, %zu bytes): %"PRIu64" frames, "
+		    "%"PRIu64" us/frame.\n",
+		    gl_tex_stream_mode_str(ts->mode), ts->size,
+		    ts->upload_count,
+		    ((ts->upload_ns / ts->upload_count) / 1000));
+		ts->upload_ns = 0;
+		ts->upload_count = 0;
+	}
+	if (0 != ts->upload_bytes_full) {
+		fprintf(stderr, "flame upload: %"PRIu64"%% bytes skipped.\n",
+		    (100 - ((ts->upload_bytes * 100) / ts->upload_bytes_full)));
+		ts->upload_bytes = 0;
+		ts->upload_bytes_full = 0;
+	}
+	/* Producer thread updates them. */
+	cells = atomic_exchange(&flame->stat_cells, 0);
+	cells_skipped = atomic_exchange(&flame->stat_cells_skipped, 0);
+	if (0 != cells) {
+		fprintf(stderr, "flame compute: %"PRIu64"%% cells skipped.\n",
+		    ((cells_skipped * 100) / cells));
+	}
+	if (0 != (fc->hits + fc->misses)) {
+		fprintf(stderr, "face cache (%zu faces, %zu MB): "
+		    "%"PRIu64"%% hits, %"PRIu64" misses.\n",
+		    fc->slots_count, (face_cache_mem_size(fc) / (1024 * 1024)),
+		    ((fc->hits * 100) / (fc->hits + fc->misses)), fc->misses);
+		fc->hits = 0;
+		fc->misses = 0;
+	}
+	if (0 != c3d_clk->stats_frames) {
+		fprintf(stderr, "GL state: %"PRIu64" calls/frame issued, "
+		    "%"PRIu64" elided.\n",
+		    (gl_state.issued / c3d_clk->stats_frames),
+		    (gl_state.elided / c3d_clk->stats_frames));
+		gl_state.issued = 0;
+		gl_state.elided = 0;
+		c3d_clk->stats_frames = 0;
+	}
+}
+
+/* Legacy path: flame quad with RGB texture bound, fixed function. */
+static void
+flame_rgb_draw(const GLfloat *rect, const size_t width, const size_t height) {
+
+	gl_state_disable(GL_LIGHTING);
+	glColor4fv(flame_color);
+	glPushMatrix();
+	{
+		glTranslatef(0.0f, 0.0f, FLAME_QUAD_Z);
+		glBegin(GL_QUADS);
+		{
+			glNormal3f(0.0f, 0.0f, 1.0f);
+			glTexCoord2f(0.0f, 0.0f);
+			glVertex3f(rect[0], rect[1], 0.0f);
+			glTexCoord2f(0.0f, (float)(height - 1));
+			glVertex3f(rect[0], rect[3], 0.0f);
+			glTexCoord2f((float)(width - 1), (float)(height - 1));
+			glVertex3f(rect[2], rect[3], 0.0f);
+			glTexCoord2f((float)(width - 1), 0.0f);
+			glVertex3f(rect[2], rect[1], 0.0f);
+		}
+		glEnd();
+	}
+	glPopMatrix();
 }
 
-/* Redraw window callback. */
 static void
 redraw_window(glx_wnd_p glx_wnd __unused, const uint32_t flags,
     const wnd_state_p ws, const mcur_pos_p mcur_pos, void *udata) {
 	c3d_clk_p c3d_clk = udata;
-	size_t i;
+	size_t i, j, ticks, flame_width, flame_height, flame_rows;
+	const void *flame_out;
 	time_t rawtime;
 	struct tm tminfo;
-	float rotation_delta;
+	float alpha;
 	uint32_t time_val[CUBES_COUNT];
+	GLfloat proj[16], spheres_inst[(nitems(sphere_x) * 3)];
+	cube_mesh_inst_t cubes_inst[CUBES_COUNT];
 	const float aspect = ((float)ws->width / (float)ws->height);
+	const GLfloat flame_rect[4] = {
+		(-FLAME_QUAD_X * aspect), FLAME_QUAD_BOTTOM,
+		(FLAME_QUAD_X * aspect), FLAME_QUAD_TOP
+	};
 	const uint64_t cur_time_ms = get_millisec();
 
 	/************************ GL initializing *********************/
 	if (0 != (GLX_WND_REDRAW_F_INIT & flags)) {
-		glEnable(GL_POLYGON_SMOOTH);
-		glEnable(GL_LINE_SMOOTH);
-		glShadeModel(GL_SMOOTH);
-		glEnable(GL_NORMALIZE);
+		gl_caps_init();
+		/* Nothing is known about new context. */
+		gl_state_invalidate();
+		gl_state_active_texture(GL_TEXTURE0);
+		if (GL_CAPS(CORE)) {
+			/* Everything is drawn by shaders. */
+			c3d_clk->face_mode = FACE_MODE_SDF;
+			c3d_clk->flame_upload = FLAME_UPLOAD_INDEX;
+		}
+		if (0 != c3d_clk->stats) {
+			fprintf(stderr, "OpenGL %i.%i%s.\n",
+			    gl_caps.major, gl_caps.minor,
+			    (GL_CAPS(CORE) ? " core profile" : ""));
+		}
+		gl_state_enable(GL_POLYGON_SMOOTH);
+		gl_state_enable(GL_LINE_SMOOTH);
 		glDepthFunc(GL_LEQUAL);
-		glEnable(GL_MULTISAMPLE);
+		gl_state_enable(GL_MULTISAMPLE);
 
-		glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
-		glHint(GL_POLYGON_SMOOTH_HINT, GL_NICEST);
+		gl_state_hint(GL_LINE_SMOOTH_HINT, GL_NICEST);
+		gl_state_hint(GL_POLYGON_SMOOTH_HINT, GL_NICEST);
 
-		glEnable(GL_COLOR_MATERIAL);
-		glEnable(GL_TEXTURE_RECTANGLE);
-		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		if (!GL_CAPS(CORE)) {
+			glShadeModel(GL_SMOOTH);
+			gl_state_enable(GL_NORMALIZE);
+			gl_state_enable(GL_COLOR_MATERIAL);
+			gl_state_enable(GL_TEXTURE_RECTANGLE);
+		}
+		gl_state_pixel_store(GL_UNPACK_ALIGNMENT, 1);
 
 		c3d_clk->mpos_x = INT32_MAX;
 		c3d_clk->mpos_y = INT32_MAX;
-		/* Init sphere objects. */
-		c3d_clk->sphere_obj = gluNewQuadric();
-		gluQuadricDrawStyle(c3d_clk->sphere_obj, GLU_FILL);
-		gluQuadricNormals(c3d_clk->sphere_obj, GLU_SMOOTH);
-
+		/* Before any failure exit: destroy releases cubes faces. */
+		for (i = 0; i < CUBES_COUNT; i ++) {
+			cube_init(c3d_clk, &c3d_clk->cubes[i], cube_x[i], 0.0f,
+			    CUBE_SWING_SPEED);
+		}
+		/* Sphere is tessellated once, it has no other draw path. */
+		if (0 != sphere_mesh_init(&c3d_clk->sphere_mesh,
+		    c3d_clk->sphere_detail, nitems(sphere_x))) {
+			fprintf(stderr, "Sphere mesh init failed.\n");
+			c3d_clk->running = 0;
+			return;
+		}
+		/* Mesh first: on failure atlas is made for face cache. */
+		if (FACE_MODE_SDF == c3d_clk->face_mode &&
+		    0 != cube_mesh_init(&c3d_clk->cube_mesh,
+		    BITMAP_WIDTH, BITMAP_HEIGHT, CUBES_COUNT)) {
+			if (GL_CAPS(CORE)) {
+				fprintf(stderr, "Cube mesh init failed, "
+				    "try -l.\n");
+				c3d_clk->running = 0;
+				return;
+			}
+			fprintf(stderr, "Cube mesh init failed, "
+			    "using face cache.\n");
+			c3d_clk->face_mode = FACE_MODE_CACHE;
+		}
 		/* Generating textures. */
-		create_digits_tex_array(c3d_clk);
+		if (0 != create_digits_tex_array(c3d_clk)) {
+			fprintf(stderr, "Cannot create digits textures.\n");
+			c3d_clk->running = 0;
+			return;
+		}
+		/* Faces are drawn on first use. */
+		if (FACE_MODE_CACHE == c3d_clk->face_mode &&
+		    0 != face_cache_init(&c3d_clk->face_cache,
+		    BITMAP_WIDTH, BITMAP_HEIGHT,
+		    (c3d_clk->face_cache_mem * 1024 * 1024),
+		    CUBES_COUNT, draw_time_edge_texture, c3d_clk)) {
+			fprintf(stderr, "Face cache init failed, "
+			    "drawing faces on change.\n");
+			c3d_clk->face_mode = FACE_MODE_DIRECT;
+		}
 
 		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
 
-		glTexParameterf(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameterf(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		glGenTextures(1, &c3d_clk->flame_tex);
-		for (i = 0; i < CUBES_COUNT; i ++) {
-			cube_init(&c3d_clk->cubes[i], cube_x[i], 0.0f, 0.2f);
-		}
+		/* Flame engine is started on first frame: size depends on
+		 * window aspect. */
+		c3d_clk->stats_time_ms = cur_time_ms;
 
 		glFlush();
 	}
@@ -623,9 +970,12 @@ redraw_window(glx_wnd_p glx_wnd __unused, const uint32_t flags,
 	/************************** Closing window ********************/
 	if (0 != (GLX_WND_REDRAW_F_DESTROY & flags)) {
 		for (i = 0; i < CUBES_COUNT; i ++) {
-			cube_destroy(&c3d_clk->cubes[i]);
+			cube_destroy(c3d_clk, &c3d_clk->cubes[i]);
 		}
-		glDeleteTextures(1, &c3d_clk->flame_tex);
+		face_cache_destroy(&c3d_clk->face_cache);
+		cube_mesh_destroy(&c3d_clk->cube_mesh);
+		sphere_mesh_destroy(&c3d_clk->sphere_mesh);
+		flame_engine_stop(c3d_clk);
 		destroy_digits_tex_array(c3d_clk);
 		return;
 	}
@@ -642,15 +992,48 @@ redraw_window(glx_wnd_p glx_wnd __unused, const uint32_t flags,
 		//c3d_clk->running = 0;
 	}
 
+	/* Flame grid follows quad size. */
+	flame_size(aspect, &flame_width, &flame_height);
+	if (flame_width != c3d_clk->flame_width ||
+	    flame_height != c3d_clk->flame_height) {
+		flame_engine_stop(c3d_clk);
+		if (0 != flame_engine_start(c3d_clk, flame_width,
+		    flame_height)) {
+			fprintf(stderr, "Cannot start flame simulation.\n");
+			c3d_clk->running = 0;
+			return;
+		}
+	}
+
 	/************************* Render to texture ******************/
-	glDisable(GL_LIGHTING);
-	glEnable(GL_TEXTURE_RECTANGLE);
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-	glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
-	glEnable(GL_COLOR_MATERIAL);
+	if (!GL_CAPS(CORE)) {
+		gl_state_disable(GL_LIGHTING);
+		gl_state_enable(GL_TEXTURE_RECTANGLE);
+		gl_state_color_material(GL_FRONT_AND_BACK,
+		    GL_AMBIENT_AND_DIFFUSE);
+		gl_state_enable(GL_COLOR_MATERIAL);
+	}
+	gl_state_pixel_store(GL_UNPACK_ALIGNMENT, 1);
 
-	/* Flame updating. */
-	flame_update(c3d_clk);
+	/* Simulation: one flame step and cubes move per tick. */
+	ticks = sim_clock_update(c3d_clk, monoclock_ns(), &alpha);
+	for (i = 0; i < CUBES_COUNT; i ++) {
+		for (j = 0; j < ticks; j ++) {
+			cube_tick(&c3d_clk->cubes[i],
+			    (1.0f / (float)c3d_clk->tick_rate));
+		}
+		cube_interpolate(&c3d_clk->cubes[i], alpha);
+	}
+	/* Flame updating: next steps are simulated while this frame renders
+	 * with the newest completed one. */
+	if (FLAME_ENGINE_GPU == c3d_clk->flame_engine) {
+		if (0 != ticks) {
+			flame_gl_step(&c3d_clk->flame_gl,
+			    (ticks * FLAME_GL_STEPS));
+		}
+	} else {
+		flame_producer_request(&c3d_clk->flame, ticks);
+	}
 
 	/*********************** Render to screen *********************/
 	/* Create framing digits on edges textures. */
@@ -659,85 +1042,102 @@ redraw_window(glx_wnd_p glx_wnd __unused, const uint32_t flags,
 	time_val[0] = (uint32_t)tminfo.tm_hour;
 	time_val[1] = (uint32_t)tminfo.tm_min;
 	time_val[2] = (uint32_t)tminfo.tm_sec;
-	/* Rotations calculation. */
-	rotation_delta = CUBE_ROTATION_SPEED * (float)(cur_time_ms - c3d_clk->prev_time_ms);
-	c3d_clk->prev_time_ms = cur_time_ms;
-	
 	for (i = 0; i < CUBES_COUNT; i ++) {
-		cube_update(c3d_clk, &c3d_clk->cubes[i], time_val[i],
-		    rotation_delta);
+		cube_update(c3d_clk, &c3d_clk->cubes[i], time_val[i]);
 	}
 
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
-	gluPerspective(50.0, (double)aspect, 0.5, 500.0);
-
-	glMatrixMode(GL_MODELVIEW);
-	glLoadIdentity();
-	gluLookAt(0.0, 0.0, 6.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0);
+	/* Shaders projection, legacy path sets same to GL_PROJECTION. */
+	gl_mat4_perspective(proj, 50.0, (double)aspect, 0.5, 500.0);
+	if (!GL_CAPS(CORE)) {
+		glMatrixMode(GL_PROJECTION);
+		glLoadMatrixf(proj);
+		glMatrixMode(GL_MODELVIEW);
+		glLoadIdentity();
+		gl_state_hint(GL_PERSPECTIVE_CORRECTION_HINT, GL_NICEST);
+	}
 	glDepthFunc(GL_LEQUAL);
-	glHint(GL_PERSPECTIVE_CORRECTION_HINT, GL_NICEST);
 	
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	glViewport(0, 0, (GLsizei)ws->width, (GLsizei)ws->height);
 
-	glLoadIdentity();
-
 	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
-	glEnable(GL_BLEND);
-	glDisable(GL_DEPTH_TEST);
+	gl_state_enable(GL_BLEND);
+	gl_state_disable(GL_DEPTH_TEST);
 
-	glBlendFunc(GL_SRC_ALPHA,GL_ONE);
-	glEnable(GL_TEXTURE_RECTANGLE);
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	gl_state_blend_func(GL_SRC_ALPHA,GL_ONE);
+	if (!GL_CAPS(CORE)) {
+		gl_state_enable(GL_TEXTURE_RECTANGLE);
+	}
+	gl_state_pixel_store(GL_UNPACK_ALIGNMENT, 1);
 
 
 	/* Drawing flame quad */
-	glBindTexture(GL_TEXTURE_RECTANGLE, c3d_clk->flame_tex);
-	glTexImage2D(GL_TEXTURE_RECTANGLE, 0, 3, FLAME_WIDTH, FLAME_HEIGHT,
-	    0, GL_RGB, GL_UNSIGNED_BYTE, c3d_clk->flame_buf);
-	glDisable(GL_LIGHTING);
-	
-	glColor4f(1.0f, 1.0f, 1.0f, 0.9f);
-	glPushMatrix();
-	{
-		glTranslatef(0.0f, 0.0f, -10.0f);
-		glBegin(GL_QUADS);
-		{
-			glNormal3f(0.0f, 0.0f, 1.0f);
-			glTexCoord2f(0.0f, 0.0f);
-			glVertex3f((-5.0f * aspect), -5.2f, 0.0f);
-			glTexCoord2f(((FLAME_WIDTH / 2) - 1), 0.0f);
-			glVertex3f((-5.0f * aspect), 4.0f, 0.0f);
-			glTexCoord2f(((FLAME_WIDTH / 2) - 1), (FLAME_HEIGHT - 1));
-			glVertex3f((5.0f * aspect), 4.0f, 0.0f);
-			glTexCoord2f(0.0f, (FLAME_HEIGHT - 1));
-			glVertex3f((5.0f * aspect), -5.2f, 0.0f);
+	if (FLAME_ENGINE_GPU == c3d_clk->flame_engine) {
+		flame_gl_draw(&c3d_clk->flame_gl, 0, proj, flame_rect,
+		    FLAME_QUAD_Z, flame_color);
+	} else {
+		flame_out = flame_producer_front(&c3d_clk->flame,
+		    &flame_rows);
+		if (NULL != flame_out) {
+			/* Rows cold in texture and in output are skipped. */
+			gl_tex_stream_upload(&c3d_clk->flame_stream,
+			    flame_out, MAX(flame_rows,
+			    c3d_clk->flame_tex_rows));
+			c3d_clk->flame_tex_rows = flame_rows;
+		} else {
+			gl_state_bind_texture(GL_TEXTURE_RECTANGLE,
+			    c3d_clk->flame_stream.tex);
+		}
+		if (FLAME_UPLOAD_INDEX == c3d_clk->flame_upload) {
+			flame_gl_draw(&c3d_clk->flame_gl,
+			    c3d_clk->flame_stream.tex, proj, flame_rect,
+			    FLAME_QUAD_Z, flame_color);
+		} else {
+			flame_rgb_draw(flame_rect, flame_width,
+			    flame_height);
 		}
-		glEnd();
 	}
-	glPopMatrix();
 
-	glEnable(GL_LIGHTING);
-	glEnable(GL_LIGHT0);
-	glLightfv(GL_LIGHT0, GL_DIFFUSE, light0Diffuse);
-	glLightfv(GL_LIGHT0, GL_AMBIENT, light0Ambient);
-	glLightfv(GL_LIGHT0, GL_POSITION, light0Direction);
+	if (!GL_CAPS(CORE)) {
+		gl_state_enable(GL_LIGHTING);
+		gl_state_enable(GL_LIGHT0);
+		gl_state_light_fv(GL_LIGHT0, GL_DIFFUSE, light0Diffuse);
+		gl_state_light_fv(GL_LIGHT0, GL_AMBIENT, light0Ambient);
+		gl_state_light_fv(GL_LIGHT0, GL_POSITION, light0Direction);
 
-	glEnable(GL_COLOR_MATERIAL);
-	glLightModelf(GL_LIGHT_MODEL_TWO_SIDE, GL_FALSE);
+		gl_state_enable(GL_COLOR_MATERIAL);
+		glLightModelf(GL_LIGHT_MODEL_TWO_SIDE, GL_FALSE);
+	}
 
 	/* Drawing time cubes. */
-	glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
-	for (i = 0; i < CUBES_COUNT; i ++) {
+	if (FACE_MODE_SDF == c3d_clk->face_mode) {
+		/* All cubes by one call, same transforms as below. */
+		for (i = 0; i < CUBES_COUNT; i ++) {
+			cubes_inst[i].pos[0] = c3d_clk->cubes[i].x;
+			cubes_inst[i].pos[1] = c3d_clk->cubes[i].y;
+			cubes_inst[i].pos[2] = range_z;
+			cubes_inst[i].pos[3] = (float)c3d_clk->cubes[i].digit;
+			cubes_inst[i].rot[0] = c3d_clk->cubes[i].draw_angle_y;
+			cubes_inst[i].rot[1] = c3d_clk->cubes[i].draw_angle_x;
+		}
+		face_sdf_draw_begin(&c3d_clk->face_sdf, proj, shader_light);
+		cube_mesh_draw(&c3d_clk->cube_mesh, cubes_inst, CUBES_COUNT);
+		face_sdf_draw_end();
+	}
+	if (FACE_MODE_SDF != c3d_clk->face_mode) {
+		glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+	}
+	for (i = 0; FACE_MODE_SDF != c3d_clk->face_mode &&
+	    i < CUBES_COUNT; i ++) {
 		glPushMatrix();
 		{
 			glTranslatef(c3d_clk->cubes[i].x,
 			    c3d_clk->cubes[i].y, range_z);
-			glRotatef(c3d_clk->cubes[i].angle_y, 1.0f, 0.0f, 0.0f);
-			glRotatef(c3d_clk->cubes[i].angle_x, 0.0f, 1.0f, 0.0f);
-			glBindTexture(GL_TEXTURE_RECTANGLE, c3d_clk->cubes[i].texture);
+			glRotatef(c3d_clk->cubes[i].draw_angle_y, 1.0f, 0.0f, 0.0f);
+			glRotatef(c3d_clk->cubes[i].draw_angle_x, 0.0f, 1.0f, 0.0f);
+			gl_state_bind_texture(GL_TEXTURE_RECTANGLE,
+			    c3d_clk->cubes[i].texture);
 			glBegin(GL_QUADS);
 			{
 				glNormal3f(0.0f, 0.0f, 0.2f);
@@ -810,15 +1210,15 @@ redraw_window(glx_wnd_p glx_wnd __unused, const uint32_t flags,
 	/* Getting path of full flame texture. */
 	glTexParameterf(GL_TEXTURE_RECTANGLE, GL_TEXTURE_WRAP_S, GL_CLAMP);
 	glTexParameterf(GL_TEXTURE_RECTANGLE, GL_TEXTURE_WRAP_T, GL_CLAMP);
-	glBindTexture(GL_TEXTURE_RECTANGLE, c3d_clk->flame_tex);
+	gl_state_bind_texture(GL_TEXTURE_RECTANGLE, c3d_clk->flame_stream.tex);
 	glColor4f(0.3f, 0.0f, 0.0f, 0.5f);
 	for (i = 0; i < CUBES_COUNT; i ++) {
 		glPushMatrix();
 		{
 			glTranslatef(c3d_clk->cubes[i].x,
 			    c3d_clk->cubes[i].y, range_z);
-			glRotatef(c3d_clk->cubes[i].angle_y, 1.0f, 0.0f, 0.0f);
-			glRotatef(c3d_clk->cubes[i].angle_x, 0.0f, 1.0f, 0.0f);
+			glRotatef(c3d_clk->cubes[i].draw_angle_y, 1.0f, 0.0f, 0.0f);
+			glRotatef(c3d_clk->cubes[i].draw_angle_x, 0.0f, 1.0f, 0.0f);
 			glBegin(GL_QUADS);
 			{
 				glNormal3f(0.0f, 0.0f, 1.0f);
@@ -888,21 +1288,23 @@ redraw_window(glx_wnd_p glx_wnd __unused, const uint32_t flags,
 #endif
 
 	/* Drawing spheres between cubes. */
-	glDisable(GL_TEXTURE_RECTANGLE);
-	glDisable(GL_BLEND);
-	glEnable(GL_DEPTH_TEST);
-	glColor3f(0.4f, 0.2f, 0.2f);
+	if (!GL_CAPS(CORE)) {
+		gl_state_disable(GL_TEXTURE_RECTANGLE);
+	}
+	gl_state_disable(GL_BLEND);
+	gl_state_enable(GL_DEPTH_TEST);
 	for (i = 0; i < nitems(sphere_x); i ++) {
-		glPushMatrix();
-		{
-			glNormal3f(0.0f, 0.0f, 1.0f);
-			glTranslatef(sphere_x[i], sphere_y[i], range_z);
-			gluSphere(c3d_clk->sphere_obj, 0.1, 16, 16);
-		}
-		glPopMatrix();
+		spheres_inst[((i * 3) + 0)] = sphere_x[i];
+		spheres_inst[((i * 3) + 1)] = sphere_y[i];
+		spheres_inst[((i * 3) + 2)] = range_z;
 	}
+	sphere_mesh_draw(&c3d_clk->sphere_mesh, proj, shader_light,
+	    sphere_color, SPHERE_RADIUS, spheres_inst, nitems(sphere_x));
 
 	glFlush();
+
+	c3d_clk->stats_frames ++;
+	stats_print(c3d_clk, cur_time_ms);
 }
 
 static void
@@ -919,28 +1321,193 @@ events_update(glx_wnd_p glx_wnd __unused, const XEvent *event,
 }
 
 
+static void
+usage(const char *prog) {
+
+	fprintf(stderr, "Usage: %s [-e cpu|gpu] [-t threads] [-u index|rgb] [-P] [-r rate] [-s seed] [-f cache|sdf] [-c MB] [-F font] [-p detail] [-l] [-R fps] [-v interval] [-S]\n"
+	    "  -e cpu|gpu	flame engine, default: cpu\n"
+	    "  -t threads	flame simulation threads, 0 - one per CPU (default)\n"
+	    "  -u index|rgb	CPU flame upload: heat with GPU palette (default) or RGB\n"
+	    "  -P		CPU flame upload via PBO ring, not directly\n"
+	    "  -r rate	simulation ticks per second, default: %u\n"
+	    "  -s seed	PRNG seed, for reproducible runs\n"
+	    "  -f cache|sdf	cube faces: cached textures or shader (default)\n"
+	    "  -c MB		cube faces cache memory cap, default: %u\n"
+	    "  -F font	digits font file, default: built in Roboto Bold\n"
+	    "  -p detail	sphere slices and stacks, %u..%u, default: %u\n"
+	    "  -l		OpenGL 2.1 fixed function path, no 3.3 core profile\n"
+	    "  -R fps	frames per second cap, 0 - none, default: %u\n"
+	    "  -v interval	vertical retraces per frame, 0 - no vsync, default: %u\n"
+	    "  -S		print stats to stderr every %u seconds\n",
+	    prog, SIM_TICK_RATE_DEF, FACE_CACHE_MEM_DEF,
+	    SPHERE_MESH_DETAIL_MIN, SPHERE_MESH_DETAIL_MAX,
+	    SPHERE_MESH_DETAIL_DEF, FRAME_FPS_DEF, SWAP_INTERVAL_DEF,
+	    (STATS_INTERVAL_MS / 1000));
+}
+
 int
-main(int argc __unused, char **argv __unused) {
-	int error;
+main(int argc, char **argv) {
+	int error, ch, redraw;
+	uint64_t now_ns;
+	struct pollfd fds[2];
 	c3d_clk_t c3d_clk;
 
 	memset(&c3d_clk, 0x00, sizeof(c3d_clk));
 	c3d_clk.running ++;
+	c3d_clk.tick_rate = SIM_TICK_RATE_DEF;
+	c3d_clk.seed = prng_seed_random();
+	c3d_clk.face_mode = FACE_MODE_SDF;
+	c3d_clk.face_cache_mem = FACE_CACHE_MEM_DEF;
+	c3d_clk.sphere_detail = SPHERE_MESH_DETAIL_DEF;
+	c3d_clk.fps = FRAME_FPS_DEF;
+	c3d_clk.swap_interval = SWAP_INTERVAL_DEF;
+
+	while (-1 != (ch = getopt(argc, argv, "e:t:u:Pr:s:f:c:F:p:lR:v:Sh"))) {
+		switch (ch) {
+		case 'e':
+			if (0 == strcmp(optarg, "cpu")) {
+				c3d_clk.flame_engine = FLAME_ENGINE_CPU;
+			} else if (0 == strcmp(optarg, "gpu")) {
+				c3d_clk.flame_engine = FLAME_ENGINE_GPU;
+			} else {
+				usage(argv[0]);
+				return (EINVAL);
+			}
+			break;
+		case 't':
+			c3d_clk.flame_threads = strtoul(optarg, NULL, 10);
+			break;
+		case 'u':
+			if (0 == strcmp(optarg, "index")) {
+				c3d_clk.flame_upload = FLAME_UPLOAD_INDEX;
+			} else if (0 == strcmp(optarg, "rgb")) {
+				c3d_clk.flame_upload = FLAME_UPLOAD_RGB;
+			} else {
+				usage(argv[0]);
+				return (EINVAL);
+			}
+			break;
+		case 'P':
+			c3d_clk.flame_pbo = 1;
+			break;
+		case 'r':
+			c3d_clk.tick_rate = (uint32_t)strtoul(optarg, NULL, 10);
+			if (0 == c3d_clk.tick_rate ||
+			    SIM_TICK_RATE_MAX < c3d_clk.tick_rate) {
+				usage(argv[0]);
+				return (EINVAL);
+			}
+			break;
+		case 's':
+			c3d_clk.seed = strtoull(optarg, NULL, 0);
+			break;
+		case 'f':
+			if (0 == strcmp(optarg, "cache")) {
+				c3d_clk.face_mode = FACE_MODE_CACHE;
+			} else if (0 == strcmp(optarg, "sdf")) {
+				c3d_clk.face_mode = FACE_MODE_SDF;
+			} else {
+				usage(argv[0]);
+				return (EINVAL);
+			}
+			break;
+		case 'c':
+			c3d_clk.face_cache_mem = strtoul(optarg, NULL, 10);
+			break;
+		case 'F':
+			c3d_clk.font_name = optarg;
+			break;
+		case 'p':
+			c3d_clk.sphere_detail = strtoul(optarg, NULL, 10);
+			if (SPHERE_MESH_DETAIL_MIN > c3d_clk.sphere_detail ||
+			    SPHERE_MESH_DETAIL_MAX < c3d_clk.sphere_detail) {
+				usage(argv[0]);
+				return (EINVAL);
+			}
+			break;
+		case 'l':
+			c3d_clk.glx_flags |= GLX_WND_F_GL_LEGACY;
+			break;
+		case 'R':
+			c3d_clk.fps = (uint32_t)strtoul(optarg, NULL, 10);
+			if (FRAME_SCHED_FPS_MAX < c3d_clk.fps) {
+				usage(argv[0]);
+				return (EINVAL);
+			}
+			break;
+		case 'v':
+			c3d_clk.swap_interval = atoi(optarg);
+			if (0 > c3d_clk.swap_interval) {
+				usage(argv[0]);
+				return (EINVAL);
+			}
+			break;
+		case 'S':
+			c3d_clk.stats = 1;
+			break;
+		case 'h':
+		default:
+			usage(argv[0]);
+			return (EINVAL);
+		}
+	}
+
+	c3d_clk.tick_ns = (1000000000ull / c3d_clk.tick_rate);
+	prng_init(&c3d_clk.prng, c3d_clk.seed);
+	if (0 != c3d_clk.stats) {
+		fprintf(stderr, "PRNG seed: %"PRIu64".\n", c3d_clk.seed);
+	}
 
-	error = glx_wnd_create(0, 0, "cube3d clock", redraw_window,
-	    events_update, &c3d_clk, &c3d_clk.glx_wnd);
+	error = glx_wnd_create(0, 0, "cube3d clock", c3d_clk.glx_flags,
+	    redraw_window, events_update, &c3d_clk, &c3d_clk.glx_wnd);
 	if (0 != error)
 		return (error);
+	if (0 != glx_wnd_swap_interval_set(&c3d_clk.glx_wnd,
+	    c3d_clk.swap_interval) &&
+	    0 != c3d_clk.stats) {
+		fprintf(stderr, "Swap interval control not supported.\n");
+	}
 	glx_wnd_hide_cursor(&c3d_clk.glx_wnd);
 	glx_wnd_set_window_fullscreen_popup(&c3d_clk.glx_wnd);
 
-	while (0 == glx_wnd_update_window(&c3d_clk.glx_wnd) &&
-	    0 != c3d_clk.running) {
-		sleep_millisec(1);
+	error = frame_sched_init(&c3d_clk.frame_sched, c3d_clk.fps);
+	if (0 != error) {
+		fprintf(stderr, "Cannot create frame timer: %i.\n", error);
+		c3d_clk.running = 0;
+	}
+	fds[0].fd = glx_wnd_fd(&c3d_clk.glx_wnd);
+	fds[0].events = POLLIN;
+	fds[1].fd = c3d_clk.frame_sched.timer_fd;
+	fds[1].events = POLLIN;
+	while (0 != c3d_clk.running) {
+		/* All queued events, then one frame at most. */
+		now_ns = monoclock_ns();
+		redraw = frame_sched_due(&c3d_clk.frame_sched, now_ns);
+		if (0 != redraw) {
+			frame_sched_start(&c3d_clk.frame_sched, now_ns);
+		}
+		if (0 != glx_wnd_update_window(&c3d_clk.glx_wnd, redraw))
+			break;
+		/* Key or button press: exit now, not on next deadline. */
+		if (0 == c3d_clk.running)
+			break;
+		if (0 != glx_wnd_pending(&c3d_clk.glx_wnd))
+			continue;
+		/* Sleep until input or frame deadline. */
+		error = frame_sched_timer_arm(&c3d_clk.frame_sched);
+		if (0 == error &&
+		    -1 == poll(fds, nitems(fds), -1) && EINTR != errno) {
+			error = errno;
+		}
+		if (0 != error) {
+			fprintf(stderr, "Frame wait failed: %i.\n", error);
+			break;
+		}
 	}
+	frame_sched_destroy(&c3d_clk.frame_sched);
 
 	glx_wnd_show_cursor(&c3d_clk.glx_wnd);
 	glx_wnd_destroy(&c3d_clk.glx_wnd);
 
-	return (0);
+	return (error);
 }
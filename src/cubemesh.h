@@ -0,0 +1,294 @@
+/*
+ *  Copyright (c) 2020-2024 Rozhuk Ivan <rozhuk.im@gmail.com>
+ *  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * File:   cubemesh.h
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ * Unit cube mesh in static vertex buffer, all cubes are drawn by one
+ * instanced call, per cube data is in small per frame buffer.
+ * Without instancing support cubes are drawn one by one from same
+ * buffers, per cube data is set as constant vertex attributes.
+ */
+
+#ifndef CUBEMESH_H
+#define CUBEMESH_H
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#include "glutils.h"
+
+
+/* Vertex attributes locations, program must bind cube_mesh_attrs. */
+#define CUBE_MESH_ATTR_POS	0
+#define CUBE_MESH_ATTR_NORMAL	1
+#define CUBE_MESH_ATTR_TC	2
+#define CUBE_MESH_ATTR_INST_POS	3 /* x, y, z, face value. */
+#define CUBE_MESH_ATTR_INST_ROT	4 /* Degrees around x, then around y. */
+
+static const char *cube_mesh_attrs[] = {
+	"pos", "normal", "tc", "inst_pos", "inst_rot", NULL
+};
+
+#define CUBE_MESH_VERTICES	24
+#define CUBE_MESH_INDICES	36
+
+typedef struct cube_mesh_vertex_s {
+	GLfloat		pos[3];
+	GLfloat		normal[3];
+	GLfloat		tc[2];		/* 0..1, scaled to face size. */
+} cube_mesh_vertex_t, *cube_mesh_vertex_p;
+
+typedef struct cube_mesh_inst_s {
+	GLfloat		pos[4];		/* CUBE_MESH_ATTR_INST_POS. */
+	GLfloat		rot[2];		/* CUBE_MESH_ATTR_INST_ROT. */
+} cube_mesh_inst_t, *cube_mesh_inst_p;
+
+typedef struct cube_mesh_s {
+	GLuint		vao;		/* 0: no VAO support. */
+	GLuint		vbo;
+	GLuint		ibo;
+	GLuint		inst_vbo;	/* 0: no instancing support. */
+	size_t		inst_max;
+} cube_mesh_t, *cube_mesh_p;
+
+
+/* Same quads as were drawn in immediate mode: front, back, top, bottom,
+ * right, left. */
+static const cube_mesh_vertex_t cube_mesh_vertices[CUBE_MESH_VERTICES] = {
+	{ {  0.5f,  0.5f,  0.5f }, {  0.0f,  0.0f,  1.0f }, { 1.0f, 1.0f } },
+	{ { -0.5f,  0.5f,  0.5f }, {  0.0f,  0.0f,  1.0f }, { 0.0f, 1.0f } },
+	{ { -0.5f, -0.5f,  0.5f }, {  0.0f,  0.0f,  1.0f }, { 0.0f, 0.0f } },
+	{ {  0.5f, -0.5f,  0.5f }, {  0.0f,  0.0f,  1.0f }, { 1.0f, 0.0f } },
+
+	{ { -0.5f, -0.5f, -0.5f }, {  0.0f,  0.0f, -1.0f }, { 1.0f, 0.0f } },
+	{ { -0.5f,  0.5f, -0.5f }, {  0.0f,  0.0f, -1.0f }, { 1.0f, 1.0f } },
+	{ {  0.5f,  0.5f, -0.5f }, {  0.0f,  0.0f, -1.0f }, { 0.0f, 1.0f } },
+	{ {  0.5f, -0.5f, -0.5f }, {  0.0f,  0.0f, -1.0f }, { 0.0f, 0.0f } },
+
+	{ {  0.5f,  0.5f,  0.5f }, {  0.0f,  1.0f,  0.0f }, { 0.0f, 0.0f } },
+	{ {  0.5f,  0.5f, -0.5f }, {  0.0f,  1.0f,  0.0f }, { 1.0f, 0.0f } },
+	{ { -0.5f,  0.5f, -0.5f }, {  0.0f,  1.0f,  0.0f }, { 1.0f, 1.0f } },
+	{ { -0.5f,  0.5f,  0.5f }, {  0.0f,  1.0f,  0.0f }, { 0.0f, 1.0f } },
+
+	{ { -0.5f, -0.5f, -0.5f }, {  0.0f, -1.0f,  0.0f }, { 1.0f, 1.0f } },
+	{ {  0.5f, -0.5f, -0.5f }, {  0.0f, -1.0f,  0.0f }, { 0.0f, 1.0f } },
+	{ {  0.5f, -0.5f,  0.5f }, {  0.0f, -1.0f,  0.0f }, { 0.0f, 0.0f } },
+	{ { -0.5f, -0.5f,  0.5f }, {  0.0f, -1.0f,  0.0f }, { 1.0f, 0.0f } },
+
+	{ {  0.5f,  0.5f,  0.5f }, {  1.0f,  0.0f,  0.0f }, { 0.0f, 1.0f } },
+	{ {  0.5f, -0.5f,  0.5f }, {  1.0f,  0.0f,  0.0f }, { 0.0f, 0.0f } },
+	{ {  0.5f, -0.5f, -0.5f }, {  1.0f,  0.0f,  0.0f }, { 1.0f, 0.0f } },
+	{ {  0.5f,  0.5f, -0.5f }, {  1.0f,  0.0f,  0.0f }, { 1.0f, 1.0f } },
+
+	{ { -0.5f, -0.5f, -0.5f }, { -1.0f,  0.0f,  0.0f }, { 0.0f, 0.0f } },
+	{ { -0.5f, -0.5f,  0.5f }, { -1.0f,  0.0f,  0.0f }, { 1.0f, 0.0f } },
+	{ { -0.5f,  0.5f,  0.5f }, { -1.0f,  0.0f,  0.0f }, { 1.0f, 1.0f } },
+	{ { -0.5f,  0.5f, -0.5f }, { -1.0f,  0.0f,  0.0f }, { 0.0f, 1.0f } },
+};
+
+
+/* Binds buffers and sets attributes pointers: VAO content. */
+static inline void
+cube_mesh_attrs_setup(cube_mesh_p cm) {
+
+	glBindBuffer(GL_ARRAY_BUFFER, cm->vbo);
+	glEnableVertexAttribArray(CUBE_MESH_ATTR_POS);
+	glVertexAttribPointer(CUBE_MESH_ATTR_POS, 3, GL_FLOAT, GL_FALSE,
+	    sizeof(cube_mesh_vertex_t),
+	    (const void*)offsetof(cube_mesh_vertex_t, pos));
+	glEnableVertexAttribArray(CUBE_MESH_ATTR_NORMAL);
+	glVertexAttribPointer(CUBE_MESH_ATTR_NORMAL, 3, GL_FLOAT, GL_FALSE,
+	    sizeof(cube_mesh_vertex_t),
+	    (const void*)offsetof(cube_mesh_vertex_t, normal));
+	glEnableVertexAttribArray(CUBE_MESH_ATTR_TC);
+	glVertexAttribPointer(CUBE_MESH_ATTR_TC, 2, GL_FLOAT, GL_FALSE,
+	    sizeof(cube_mesh_vertex_t),
+	    (const void*)offsetof(cube_mesh_vertex_t, tc));
+	if (0 != cm->inst_vbo) {
+		glBindBuffer(GL_ARRAY_BUFFER, cm->inst_vbo);
+		glEnableVertexAttribArray(CUBE_MESH_ATTR_INST_POS);
+		glVertexAttribPointer(CUBE_MESH_ATTR_INST_POS, 4, GL_FLOAT,
+		    GL_FALSE, sizeof(cube_mesh_inst_t),
+		    (const void*)offsetof(cube_mesh_inst_t, pos));
+		glVertexAttribDivisor(CUBE_MESH_ATTR_INST_POS, 1);
+		glEnableVertexAttribArray(CUBE_MESH_ATTR_INST_ROT);
+		glVertexAttribPointer(CUBE_MESH_ATTR_INST_ROT, 2, GL_FLOAT,
+		    GL_FALSE, sizeof(cube_mesh_inst_t),
+		    (const void*)offsetof(cube_mesh_inst_t, rot));
+		glVertexAttribDivisor(CUBE_MESH_ATTR_INST_ROT, 1);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cm->ibo);
+}
+
+static inline void
+cube_mesh_attrs_cleanup(cube_mesh_p cm) {
+
+	glDisableVertexAttribArray(CUBE_MESH_ATTR_POS);
+	glDisableVertexAttribArray(CUBE_MESH_ATTR_NORMAL);
+	glDisableVertexAttribArray(CUBE_MESH_ATTR_TC);
+	if (0 != cm->inst_vbo) {
+		glVertexAttribDivisor(CUBE_MESH_ATTR_INST_POS, 0);
+		glDisableVertexAttribArray(CUBE_MESH_ATTR_INST_POS);
+		glVertexAttribDivisor(CUBE_MESH_ATTR_INST_ROT, 0);
+		glDisableVertexAttribArray(CUBE_MESH_ATTR_INST_ROT);
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+
+static inline void
+cube_mesh_destroy(cube_mesh_p cm) {
+
+	if (NULL == cm)
+		return;
+	if (0 != cm->vao) {
+		glDeleteVertexArrays(1, &cm->vao);
+	}
+	glDeleteBuffers(1, &cm->vbo);
+	glDeleteBuffers(1, &cm->ibo);
+	glDeleteBuffers(1, &cm->inst_vbo);
+	memset(cm, 0x00, sizeof(cube_mesh_t));
+}
+
+/* Creates mesh with face texture coordinates (0, 0) - (tc_width,
+ * tc_height), inst_max - max cubes drawn by one call.
+ * gl_caps_init() must be called before.
+ * Returns 0 on success. */
+static inline int
+cube_mesh_init(cube_mesh_p cm, const float tc_width, const float tc_height,
+    const size_t inst_max) {
+	size_t i;
+	cube_mesh_vertex_t vertices[CUBE_MESH_VERTICES];
+	GLubyte indices[CUBE_MESH_INDICES];
+
+	if (NULL == cm || 0 == inst_max)
+		return (EINVAL);
+	memset(cm, 0x00, sizeof(cube_mesh_t));
+	cm->inst_max = inst_max;
+
+	memcpy(vertices, cube_mesh_vertices, sizeof(vertices));
+	for (i = 0; i < CUBE_MESH_VERTICES; i ++) {
+		vertices[i].tc[0] *= tc_width;
+		vertices[i].tc[1] *= tc_height;
+	}
+	/* Quad: 2 triangles. */
+	for (i = 0; i < (CUBE_MESH_VERTICES / 4); i ++) {
+		indices[((i * 6) + 0)] = (GLubyte)((i * 4) + 0);
+		indices[((i * 6) + 1)] = (GLubyte)((i * 4) + 1);
+		indices[((i * 6) + 2)] = (GLubyte)((i * 4) + 2);
+		indices[((i * 6) + 3)] = (GLubyte)((i * 4) + 0);
+		indices[((i * 6) + 4)] = (GLubyte)((i * 4) + 2);
+		indices[((i * 6) + 5)] = (GLubyte)((i * 4) + 3);
+	}
+	glGenBuffers(1, &cm->vbo);
+	glGenBuffers(1, &cm->ibo);
+	if (0 == cm->vbo || 0 == cm->ibo) {
+		cube_mesh_destroy(cm);
+		return (ENOMEM);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, cm->vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices,
+	    GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cm->ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
+	    GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	if (GL_CAPS(INSTANCED)) {
+		glGenBuffers(1, &cm->inst_vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, cm->inst_vbo);
+		glBufferData(GL_ARRAY_BUFFER,
+		    (GLsizeiptr)(sizeof(cube_mesh_inst_t) * inst_max), NULL,
+		    GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	if (GL_CAPS(VAO)) {
+		glGenVertexArrays(1, &cm->vao);
+		glBindVertexArray(cm->vao);
+		cube_mesh_attrs_setup(cm);
+		glBindVertexArray(0);
+		/* Element buffer binding is VAO state. */
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+
+	return (0);
+}
+
+/* Draws count cubes with program that binds cube_mesh_attrs in use. */
+static inline void
+cube_mesh_draw(cube_mesh_p cm, const cube_mesh_inst_t *inst,
+    const size_t count) {
+	size_t i;
+
+	if (0 == count || cm->inst_max < count)
+		return;
+	if (0 != cm->inst_vbo) {
+		/* Orphan old content: no wait for previous frame draw. */
+		glBindBuffer(GL_ARRAY_BUFFER, cm->inst_vbo);
+		glBufferData(GL_ARRAY_BUFFER,
+		    (GLsizeiptr)(sizeof(cube_mesh_inst_t) * cm->inst_max),
+		    NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0,
+		    (GLsizeiptr)(sizeof(cube_mesh_inst_t) * count), inst);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+	if (0 != cm->vao) {
+		glBindVertexArray(cm->vao);
+	} else {
+		cube_mesh_attrs_setup(cm);
+	}
+	if (0 != cm->inst_vbo) {
+		glDrawElementsInstanced(GL_TRIANGLES, CUBE_MESH_INDICES,
+		    GL_UNSIGNED_BYTE, NULL, (GLsizei)count);
+	} else {
+		for (i = 0; i < count; i ++) {
+			glVertexAttrib4fv(CUBE_MESH_ATTR_INST_POS,
+			    inst[i].pos);
+			glVertexAttrib2fv(CUBE_MESH_ATTR_INST_ROT,
+			    inst[i].rot);
+			glDrawElements(GL_TRIANGLES, CUBE_MESH_INDICES,
+			    GL_UNSIGNED_BYTE, NULL);
+		}
+	}
+	if (0 != cm->vao) {
+		glBindVertexArray(0);
+	} else {
+		cube_mesh_attrs_cleanup(cm);
+	}
+}
+
+
+#endif /* CUBEMESH_H */
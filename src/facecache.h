@@ -0,0 +1,269 @@
+/*
+ *  Copyright (c) 2020-2024 Rozhuk Ivan <rozhuk.im@gmail.com>
+ *  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * File:   facecache.h
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ * Cache of rendered cube faces: each face is drawn once into texture
+ * slot, slots count is limited by memory cap, least recently used not
+ * referenced slot is reused when all are busy.
+ * Faces are drawn into framebuffer object with slot texture attached, or,
+ * without FBO support, into current draw buffer and copied to slot.
+ */
+
+#ifndef FACECACHE_H
+#define FACECACHE_H
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#include "glutils.h"
+#include "glstate.h"
+
+
+#define FACE_CACHE_FACES_MAX	100
+#define FACE_CACHE_NONE		((size_t)~0)
+/* Default memory cap, MB. */
+#define FACE_CACHE_MEM_DEF	64
+
+/* Draws face into current framebuffer at (0, 0) - (width, height). */
+typedef void (*face_cache_draw_cb)(void *udata, const uint32_t face);
+
+typedef struct face_cache_slot_s {
+	GLuint		tex;		/* GL_TEXTURE_RECTANGLE. */
+	uint32_t	face;		/* Drawn face or FACE_CACHE_NONE. */
+	size_t		refs;		/* Slot is not reused while in use. */
+	uint64_t	used;		/* LRU clock value of last get. */
+} face_cache_slot_t, *face_cache_slot_p;
+
+typedef struct face_cache_s {
+	face_cache_draw_cb draw_cb;
+	void		*udata;
+	GLsizei		width;
+	GLsizei		height;
+	size_t		slots_count;
+	face_cache_slot_p slots;
+	GLuint		fbo;		/* 0: copy from draw buffer. */
+	GLuint		depth_rb;	/* FBO depth and stencil. */
+	size_t		face_slot[FACE_CACHE_FACES_MAX]; /* Or FACE_CACHE_NONE. */
+	uint64_t	clock;
+	/* Stats. */
+	uint64_t	hits;
+	uint64_t	misses;
+} face_cache_t, *face_cache_p;
+
+
+static inline void
+face_cache_destroy(face_cache_p fc) {
+	size_t i;
+
+	if (NULL == fc)
+		return;
+	if (NULL != fc->slots) {
+		for (i = 0; i < fc->slots_count; i ++) {
+			gl_state_delete_textures(1, &fc->slots[i].tex);
+		}
+		free(fc->slots);
+	}
+	if (0 != fc->fbo) {
+		glDeleteFramebuffers(1, &fc->fbo);
+	}
+	if (0 != fc->depth_rb) {
+		glDeleteRenderbuffers(1, &fc->depth_rb);
+	}
+	memset(fc, 0x00, sizeof(face_cache_t));
+	/* face_cache_put() is safe after destroy or failed init. */
+	for (i = 0; i < FACE_CACHE_FACES_MAX; i ++) {
+		fc->face_slot[i] = FACE_CACHE_NONE;
+	}
+}
+
+/* Creates cache for faces of width x height RGBA pixels in mem_cap
+ * bytes, but at least for slots_min faces: faces used at same time.
+ * Without FBO window must be not smaller than face.
+ * gl_caps_init() must be called before.
+ * Returns 0 on success. */
+static inline int
+face_cache_init(face_cache_p fc, const GLsizei width, const GLsizei height,
+    const size_t mem_cap, const size_t slots_min,
+    face_cache_draw_cb draw_cb, void *udata) {
+	size_t i, face_size;
+	GLenum status;
+
+	if (NULL == fc || 0 == width || 0 == height || 0 == slots_min ||
+	    NULL == draw_cb)
+		return (EINVAL);
+	memset(fc, 0x00, sizeof(face_cache_t));
+	for (i = 0; i < FACE_CACHE_FACES_MAX; i ++) {
+		fc->face_slot[i] = FACE_CACHE_NONE;
+	}
+	fc->draw_cb = draw_cb;
+	fc->udata = udata;
+	fc->width = width;
+	fc->height = height;
+	face_size = ((size_t)width * (size_t)height * 4);
+	fc->slots_count = MIN(MAX((mem_cap / face_size), slots_min),
+	    FACE_CACHE_FACES_MAX);
+	fc->slots = calloc(fc->slots_count, sizeof(face_cache_slot_t));
+	if (NULL == fc->slots)
+		return (ENOMEM);
+	for (i = 0; i < fc->slots_count; i ++) {
+		fc->slots[i].face = (uint32_t)FACE_CACHE_NONE;
+	}
+	/* Storage is allocated once, faces are drawn over it. */
+	for (i = 0; i < fc->slots_count; i ++) {
+		glGenTextures(1, &fc->slots[i].tex);
+		if (0 == fc->slots[i].tex) {
+			face_cache_destroy(fc);
+			return (ENOMEM);
+		}
+		gl_state_bind_texture(GL_TEXTURE_RECTANGLE, fc->slots[i].tex);
+		glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MIN_FILTER,
+		    GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MAG_FILTER,
+		    GL_LINEAR);
+		if (GL_CAPS(TEX_STORAGE)) {
+			glTexStorage2D(GL_TEXTURE_RECTANGLE, 1, GL_RGBA8,
+			    width, height);
+		} else {
+			glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA8,
+			    width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		}
+	}
+	gl_state_bind_texture(GL_TEXTURE_RECTANGLE, 0);
+	if (GL_CAPS(FBO)) {
+		/* Same buffers as window has: draw_cb may clear and test
+		 * depth and stencil. */
+		glGenRenderbuffers(1, &fc->depth_rb);
+		glBindRenderbuffer(GL_RENDERBUFFER, fc->depth_rb);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8,
+		    width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		glGenFramebuffers(1, &fc->fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, fc->fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+		    GL_TEXTURE_RECTANGLE, fc->slots[0].tex, 0);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER,
+		    GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER,
+		    fc->depth_rb);
+		status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		if (GL_FRAMEBUFFER_COMPLETE != status) {
+			fprintf(stderr, "Face framebuffer incomplete: 0x%x.\n",
+			    status);
+			face_cache_destroy(fc);
+			return (EOPNOTSUPP);
+		}
+	}
+
+	return (0);
+}
+
+/* Returns size of textures memory used by cache. */
+static inline size_t
+face_cache_mem_size(const face_cache_p fc) {
+
+	return ((size_t)fc->width * (size_t)fc->height * 4 * fc->slots_count);
+}
+
+/* Returns texture with face drawn, draws it on miss.
+ * Texture stays valid until face_cache_put(). */
+static inline GLuint
+face_cache_get(face_cache_p fc, const uint32_t face) {
+	size_t i, slot_idx;
+	face_cache_slot_p slot = NULL;
+
+	if (FACE_CACHE_FACES_MAX <= face)
+		return (0);
+	fc->clock ++;
+	slot_idx = fc->face_slot[face];
+	if (FACE_CACHE_NONE != slot_idx) {
+		fc->hits ++;
+		slot = &fc->slots[slot_idx];
+		slot->refs ++;
+		slot->used = fc->clock;
+		return (slot->tex);
+	}
+	/* Miss: take free or least recently used slot. */
+	fc->misses ++;
+	for (i = 0; i < fc->slots_count; i ++) {
+		if (0 != fc->slots[i].refs)
+			continue;
+		if (NULL == slot || fc->slots[i].used < slot->used) {
+			slot = &fc->slots[i];
+		}
+	}
+	if (NULL == slot) /* slots_min was too small. */
+		return (0);
+	slot_idx = (size_t)(slot - fc->slots);
+	if ((uint32_t)FACE_CACHE_NONE != slot->face) {
+		fc->face_slot[slot->face] = FACE_CACHE_NONE;
+	}
+	slot->face = face;
+	slot->refs = 1;
+	slot->used = fc->clock;
+	fc->face_slot[face] = slot_idx;
+	if (0 != fc->fbo) {
+		glBindFramebuffer(GL_FRAMEBUFFER, fc->fbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+		    GL_TEXTURE_RECTANGLE, slot->tex, 0);
+		fc->draw_cb(fc->udata, face);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	} else {
+		fc->draw_cb(fc->udata, face);
+		gl_state_bind_texture(GL_TEXTURE_RECTANGLE, slot->tex);
+		glCopyTexSubImage2D(GL_TEXTURE_RECTANGLE, 0, 0, 0, 0, 0,
+		    fc->width, fc->height);
+	}
+
+	return (slot->tex);
+}
+
+/* Releases face got by face_cache_get(). */
+static inline void
+face_cache_put(face_cache_p fc, const uint32_t face) {
+	size_t slot_idx;
+
+	if (FACE_CACHE_FACES_MAX <= face)
+		return;
+	slot_idx = fc->face_slot[face];
+	if (FACE_CACHE_NONE == slot_idx ||
+	    0 == fc->slots[slot_idx].refs)
+		return;
+	fc->slots[slot_idx].refs --;
+}
+
+
+#endif /* FACECACHE_H */
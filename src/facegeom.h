@@ -0,0 +1,48 @@
+/*
+ *  Copyright (c) 2020-2024 Rozhuk Ivan <rozhuk.im@gmail.com>
+ *  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * File:   facegeom.h
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ * Cube face frame geometry in face pixels, shared by fixed function
+ * face template and SDF face shader, so both draw the same picture.
+ * Values are integers: they are also pasted into GLSL source.
+ */
+
+#ifndef FACEGEOM_H
+#define FACEGEOM_H
+
+
+#define FACE_BORDER_WIDTH	20 /* Border along each edge. */
+#define FACE_CATHET		90 /* Corner triangles cathet. */
+#define FACE_LINE_INSET		72 /* Line loop corner cut: 0.8 of cathet. */
+#define FACE_LINE_WIDTH		3
+
+#define FACE_GEOM_STR_(x)	#x
+#define FACE_GEOM_STR(x)	FACE_GEOM_STR_(x)
+
+
+#endif /* FACEGEOM_H */
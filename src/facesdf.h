@@ -0,0 +1,270 @@
+/*
+ *  Copyright (c) 2020-2024 Rozhuk Ivan <rozhuk.im@gmail.com>
+ *  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * File:   facesdf.h
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ * Cube faces composed by fragment shader: frame is procedural, digits
+ * are sampled from signed distance field atlas, so face is crisp at any
+ * size and nothing is redrawn when value changes.
+ * Program draws cube_mesh_t cubes: face value is per cube attribute,
+ * digits placement is looked up by vertex shader.
+ */
+
+#ifndef FACESDF_H
+#define FACESDF_H
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#include "glutils.h"
+#include "glstate.h"
+#include "sdfbake.h"
+#include "cubemesh.h"
+#include "facegeom.h"
+
+
+typedef struct face_sdf_s {
+	GLuint		tex;		/* Atlas, GL_TEXTURE_RECTANGLE. */
+	GLuint		prog;
+	GLint		proj_loc;
+	GLint		light_loc;
+} face_sdf_t, *face_sdf_p;
+
+
+/* Cube transform is same as glTranslatef(inst_pos.xyz),
+ * glRotatef(inst_rot.x, 1, 0, 0), glRotatef(inst_rot.y, 0, 1, 0), view
+ * is identity. Lighting is fixed function one with single directional
+ * light, white material and diffuse. */
+static const char *face_sdf_vs =
+	"uniform mat4 proj;\n"
+	"uniform vec4 light;\n" /* Eye space direction, ambient sum. */
+	"uniform vec2 size;\n"
+	"uniform float glyph_y;\n"
+	"uniform vec3 glyph_size[10];\n" /* w, h, advance: w + left. */
+	"uniform vec2 glyph_at[10];\n" /* Atlas x, y of glyph bitmap. */
+	"VS_IN vec3 pos;\n"
+	"VS_IN vec3 normal;\n"
+	"VS_IN vec2 tc;\n"
+	"VS_IN vec4 inst_pos;\n"
+	"VS_IN vec2 inst_rot;\n"
+	"VS_OUT vec2 face_tc;\n"
+	"VS_OUT vec4 color;\n"
+	"VS_OUT vec4 glyph_pos0;\n" /* Face x, y, w, h. */
+	"VS_OUT vec4 glyph_pos1;\n"
+	"VS_OUT vec4 glyph_tex;\n" /* Atlas x, y of both glyphs. */
+	"void main() {\n"
+	"	vec2 a = radians(inst_rot);\n"
+	"	vec2 c = cos(a), s = sin(a);\n"
+	"	mat3 r = mat3(1.0, 0.0, 0.0, 0.0, c.x, s.x, 0.0, -s.x, c.x);\n"
+	"	r *= mat3(c.y, 0.0, -s.y, 0.0, 1.0, 0.0, s.y, 0.0, c.y);\n"
+	"	float l = max(dot((r * normal), light.xyz), 0.0);\n"
+	"	int d0 = int(mod(floor((inst_pos.w / 10.0)), 10.0));\n"
+	"	int d1 = int(mod(inst_pos.w, 10.0));\n"
+	"	float x = ((size.x * 0.5) - glyph_size[d0].z);\n"
+	"	gl_Position = (proj * vec4(((r * pos) + inst_pos.xyz), 1.0));\n"
+	"	color = vec4(vec3(min((light.w + l), 1.0)), 1.0);\n"
+	"	face_tc = tc;\n"
+	"	glyph_pos0 = vec4(x, glyph_y, glyph_size[d0].xy);\n"
+	"	glyph_pos1 = vec4((x + glyph_size[d0].z), glyph_y,\n"
+	"	    glyph_size[d1].xy);\n"
+	"	glyph_tex = vec4(glyph_at[d0], glyph_at[d1]);\n"
+	"}\n";
+
+/* Face in texture coordinates (0, 0) - (face size), multiplied by color:
+ * same picture as draw_time_edge_texture() draws, frame sizes are
+ * taken from facegeom.h. */
+static const char *face_sdf_fs =
+	"uniform sampler2DRect sdf;\n"
+	"uniform vec2 size;\n"
+	"FS_IN vec2 face_tc;\n"
+	"FS_IN vec4 color;\n"
+	"FS_IN vec4 glyph_pos0;\n"
+	"FS_IN vec4 glyph_pos1;\n"
+	"FS_IN vec4 glyph_tex;\n"
+	"const float scale = 4.0;\n" /* FACE_SDF_SCALE. */
+	"const float spread = 16.0;\n" /* FACE_SDF_SPREAD. */
+	"const float border = float(" FACE_GEOM_STR(FACE_BORDER_WIDTH) ");\n"
+	"const float cathet = float(" FACE_GEOM_STR(FACE_CATHET) ");\n"
+	"const float inset = float(" FACE_GEOM_STR(FACE_LINE_INSET) ");\n"
+	"const float line_width = float(" FACE_GEOM_STR(FACE_LINE_WIDTH) ");\n"
+	"float px;\n" /* Face units per screen pixel. */
+	/* Coverage of shape with signed distance d, < 0 inside. */
+	"float cover(float d) {\n"
+	"	return (clamp((0.5 - (d / px)), 0.0, 1.0));\n"
+	"}\n"
+	"float seg_dist(vec2 p, vec2 a, vec2 b) {\n"
+	"	vec2 pa = (p - a), ba = (b - a);\n"
+	"	float h = clamp((dot(pa, ba) / dot(ba, ba)), 0.0, 1.0);\n"
+	"	return (length(pa - ba * h));\n"
+	"}\n"
+	"float glyph_cover(vec4 pos, vec2 at, vec2 p) {\n"
+	"	vec2 uv = vec2((p.x - pos.x), (pos.y + pos.w - p.y));\n"
+	"	if (any(lessThan(uv, vec2(0.0))) ||\n"
+	"	    any(greaterThan(uv, pos.zw)))\n"
+	"		return (0.0);\n"
+	"	float d = texture2DRect(sdf, (at + uv / scale)).r;\n"
+	"	return (cover(((0.5 - d) * 2.0 * spread)));\n"
+	"}\n"
+	"void main() {\n"
+	"	vec2 p = face_tc;\n"
+	"	vec2 e = (size - 1.0);\n"
+	/* Both axes are symmetric: fold to bottom left quarter. */
+	"	vec2 q = min(p, (e - p));\n"
+	"	vec4 c, line = vec4(1.0, 0.9, 0.1, 0.7);\n"
+	"	float d, g;\n"
+	"	px = max(max(fwidth(p.x), fwidth(p.y)), 0.001);\n"
+	"	c = vec4(0.0, 0.1, 0.1, 0.9);\n"
+	/* Borders and corner triangles. */
+	"	d = min((min(q.x, q.y) - border),\n"
+	"	    ((q.x + q.y - cathet) * 0.7071));\n"
+	"	c = mix(c, vec4(0.1, 0.1, 1.0, 0.9), cover(d));\n"
+	/* Line loop. */
+	"	d = seg_dist(q, vec2(inset, border), vec2(border, inset));\n"
+	"	if (q.x > inset) d = min(d, abs(q.y - border));\n"
+	"	if (q.y > inset) d = min(d, abs(q.x - border));\n"
+	"	c = mix(c, line, cover((d - (line_width * 0.5))));\n"
+	/* Digits blended over. */
+	"	g = (0.9 * 0.97 * max(glyph_cover(glyph_pos0, glyph_tex.xy, p),\n"
+	"	    glyph_cover(glyph_pos1, glyph_tex.zw, p)));\n"
+	"	c = vec4(mix(c.rgb, vec3(1.0), g), (g * g + c.a * (1.0 - g)));\n"
+	/* Nothing drawn out of face edge. */
+	"	c *= cover(max((p.x - e.x), (p.y - e.y)));\n"
+	"	FRAG_COLOR = (color * c);\n"
+	"}\n";
+
+
+static inline void
+face_sdf_destroy(face_sdf_p fs) {
+
+	if (NULL == fs)
+		return;
+	gl_state_delete_textures(1, &fs->tex);
+	if (0 != fs->prog) {
+		glDeleteProgram(fs->prog);
+	}
+	memset(fs, 0x00, sizeof(face_sdf_t));
+}
+
+/* Creates atlas texture from width x height texels of atlas and draw
+ * program, glyphs - placement of 0..9 in atlas.
+ * Face is face_width x face_height, glyphs bottom is at glyph_y, they
+ * are centered as draw_time_edge_texture() does.
+ * Returns 0 on success. */
+static inline int
+face_sdf_init(face_sdf_p fs, const uint8_t *atlas, const GLsizei width,
+    const GLsizei height, const face_sdf_glyph_t *glyphs,
+    const float face_width, const float face_height, const float glyph_y) {
+	size_t i;
+	GLenum int_fmt, fmt;
+	GLfloat glyph_size[(FACE_SDF_GLYPHS * 3)];
+	GLfloat glyph_at[(FACE_SDF_GLYPHS * 2)];
+
+	if (NULL == fs || NULL == atlas || NULL == glyphs)
+		return (EINVAL);
+	memset(fs, 0x00, sizeof(face_sdf_t));
+	if (!GL_CAPS(GLSL))
+		return (ENOTSUP);
+	for (i = 0; i < FACE_SDF_GLYPHS; i ++) {
+		glyph_size[((i * 3) + 0)] = (float)glyphs[i].width;
+		glyph_size[((i * 3) + 1)] = (float)glyphs[i].height;
+		glyph_size[((i * 3) + 2)] =
+		    (float)(glyphs[i].width + (uint32_t)glyphs[i].left);
+		glyph_at[((i * 2) + 0)] =
+		    (float)(glyphs[i].tex_x + FACE_SDF_PAD);
+		glyph_at[((i * 2) + 1)] =
+		    (float)(glyphs[i].tex_y + FACE_SDF_PAD);
+	}
+
+	fs->prog = gl_program_create(face_sdf_vs, face_sdf_fs,
+	    cube_mesh_attrs);
+	if (0 == fs->prog)
+		return (ENOTSUP);
+	gl_state_use_program(fs->prog);
+	glUniform1i(glGetUniformLocation(fs->prog, "sdf"), 0);
+	glUniform2f(glGetUniformLocation(fs->prog, "size"),
+	    face_width, face_height);
+	glUniform1f(glGetUniformLocation(fs->prog, "glyph_y"), glyph_y);
+	glUniform3fv(glGetUniformLocation(fs->prog, "glyph_size"),
+	    FACE_SDF_GLYPHS, glyph_size);
+	glUniform2fv(glGetUniformLocation(fs->prog, "glyph_at"),
+	    FACE_SDF_GLYPHS, glyph_at);
+	fs->proj_loc = glGetUniformLocation(fs->prog, "proj");
+	fs->light_loc = glGetUniformLocation(fs->prog, "light");
+	gl_state_use_program(0);
+
+	if (GL_CAPS(TEXTURE_RG)) {
+		int_fmt = GL_R8;
+		fmt = GL_RED;
+	} else {
+		int_fmt = GL_LUMINANCE8;
+		fmt = GL_LUMINANCE;
+	}
+	glGenTextures(1, &fs->tex);
+	gl_state_bind_texture(GL_TEXTURE_RECTANGLE, fs->tex);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_WRAP_S,
+	    GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_WRAP_T,
+	    GL_CLAMP_TO_EDGE);
+	gl_state_pixel_store(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_RECTANGLE, 0, (GLint)int_fmt, width, height,
+	    0, fmt, GL_UNSIGNED_BYTE, atlas);
+	gl_state_bind_texture(GL_TEXTURE_RECTANGLE, 0);
+
+	return (0);
+}
+
+/* Binds atlas and program: cube_mesh_draw() after this draws cubes with
+ * faces, inst_pos.w is face value.
+ * proj - column major projection matrix, light - eye space direction to
+ * light and ambient lighting sum. */
+static inline void
+face_sdf_draw_begin(face_sdf_p fs, const GLfloat *proj, const GLfloat *light) {
+
+	gl_state_use_program(fs->prog);
+	glUniformMatrix4fv(fs->proj_loc, 1, GL_FALSE, proj);
+	glUniform4fv(fs->light_loc, 1, light);
+	gl_state_bind_texture(GL_TEXTURE_RECTANGLE, fs->tex);
+}
+
+static inline void
+face_sdf_draw_end(void) {
+
+	gl_state_use_program(0);
+}
+
+
+#endif /* FACESDF_H */
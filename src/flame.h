@@ -0,0 +1,1155 @@
+/*
+ *  Copyright (c) 2002-2020 Naezzhy Petr(Наезжий Пётр) <petn@mail.ru>
+ *  Copyright (c) 2020-2024 Rozhuk Ivan <rozhuk.im@gmail.com>
+ *  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * File:   flame.h
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ * Flame simulation: scalar reference and SIMD row kernels.
+ */
+
+#ifndef FLAME_H
+#define FLAME_H
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "prng.h"
+
+#if defined(__x86_64__) || defined(__amd64__)
+#	define FLAME_SIMD_X86	1
+#	include <emmintrin.h>
+#	if defined(__GNUC__) || defined(__clang__)
+#		define FLAME_SIMD_AVX2	1
+#		include <immintrin.h>
+#	endif
+#elif defined(__aarch64__)
+#	define FLAME_SIMD_NEON	1
+#	include <arm_neon.h>
+#endif
+
+
+/* Grid size limits, size itself is set by flame_init(). */
+#define FLAME_SIZE_MIN		16
+#define FLAME_SIZE_MAX		4096
+
+/* Flame seeds: one random heat value per group of columns. */
+#define FLAME_SEED_GROUP	8
+
+/* Worker threads: grid is split by columns into one band per thread.
+ * Band edges are cache line aligned, so threads never write to the
+ * same line.
+ * Band touches at least FLAME_BAND_MIN_BYTES per row: each row waits
+ * for both neighbours, so narrower bands spend more time in sync than
+ * in computing, small grids are computed by less threads. 1 KiB gives
+ * 128 columns: default 989 columns wide grid (16:9) runs up to 7
+ * threads, 4:3 one runs 5.
+ * FLAME_BAND_COL_BYTES: bytes touched per column in one row: heat, p1
+ * and old of rows (j - 1) and j, RGB output. */
+#define FLAME_THREADS_MAX	16
+#define FLAME_BAND_ALIGN	64
+#define FLAME_BAND_MIN_BYTES	1024
+#define FLAME_BAND_COL_BYTES	(6 + sizeof(rgb_t))
+#define FLAME_BAND_MIN_WIDTH						\
+	roundup(howmany(FLAME_BAND_MIN_BYTES, FLAME_BAND_COL_BYTES),	\
+	    FLAME_BAND_ALIGN)
+/* Spins waiting for neighbour band before yielding CPU. */
+#define FLAME_BAND_SPINS	256
+
+/* Triple buffered output: producer thread writes one buffer, render
+ * thread reads other, third is the newest complete one. */
+#define FLAME_OUT_BUFS		3
+#define FLAME_OUT_FRESH		(((uint32_t)1) << 31)
+#define FLAME_OUT_IDX_MASK	(FLAME_OUT_FRESH - 1)
+/* Max steps producer catches up at once, older requests are dropped
+ * if simulation is slower than requested. */
+#define FLAME_PROD_STEPS_MAX	4
+
+/* Heat grid and output buffers are megabytes each: superpage aligned,
+ * so they are backed by few TLB entries where system can do it. */
+#define FLAME_MEM_ALIGN		(2 * 1024 * 1024)
+
+/* Output format. */
+#define FLAME_OUT_RGB		0 /* rgb_t per cell, palette applied. */
+#define FLAME_OUT_INDEX		1 /* Heat (palette index) byte per cell. */
+
+/* Fixed-point reciprocal of 2.97:
+ * ((sum * FLAME_DIV_MUL) >> 16) == (uint32_t)(sum / 2.97f)
+ * for every sum of three heat values: 0 <= sum <= 765.
+ * Checked by flame_selftest(). */
+#define FLAME_DIV_MUL		22066
+#define FLAME_DIV_SHIFT		16
+
+
+typedef struct rgb_s {
+	uint8_t		r;
+	uint8_t		g;
+	uint8_t		b;
+} rgb_t, *rgb_p;
+
+/* Rows used by kernel to compute one flame row.
+ * _prev - row (j - 1), _cur - row j.
+ * p1 - first pass heat, old - heat before this step,
+ * heat - second pass (final) heat.
+ * Output goes to rgb_cur or, if it is NULL, to idx_cur. */
+typedef struct flame_rows_s {
+	const uint8_t	*p1_prev;
+	const uint8_t	*old_prev;
+	const uint8_t	*heat_prev;
+	uint8_t		*p1_cur;
+	uint8_t		*old_cur;
+	uint8_t		*heat_cur;
+	rgb_p		rgb_cur;
+	uint8_t		*idx_cur;
+	const rgb_t	*palit;
+} flame_rows_t, *flame_rows_p;
+
+/* Computes columns [b, e) of one row, 1 <= b < e <= (width - 1). */
+typedef void (*flame_row_fn)(const flame_rows_p rows, size_t b, size_t e);
+
+typedef struct flame_band_s {
+	/* Rows of current step completed by this band, written by owner
+	 * only. Each row needs row (j - 1) of both neighbours (wavefront). */
+	_Alignas(FLAME_BAND_ALIGN) _Atomic size_t rows_done;
+	size_t		b;		/* First column. */
+	size_t		e;		/* Column after last. */
+	size_t		rows_top;	/* Rows [0, rows_top) computed. */
+	struct flame_s	*flame;
+	pthread_t	thread;
+} flame_band_t, *flame_band_p;
+
+typedef struct flame_s {
+	size_t		width;
+	size_t		height;
+	/* Heat grid, row major: FLAME_HEAT(x, y), y = 0 is seed row.
+	 * Rows are computed bottom to top, each row left to right, so
+	 * every step streams through memory once. */
+	uint8_t		*heat;
+	/* First pass and pre-step heat of last three rows: neighbour
+	 * band may be one row ahead. */
+	uint8_t		*p1_rows[3];
+	uint8_t		*old_rows[3];
+	/* Heat decays, so upper rows are cold most of time. Rows
+	 * [rows_hot, height) are all zero, they are not computed while
+	 * stay so. hot_step[j] == step_no: row j not cold in this step. */
+	size_t		rows_hot;
+	uint64_t	step_no;
+	_Atomic uint64_t *hot_step;
+	/* Stats, cells computed and skipped. */
+	_Atomic uint64_t stat_cells;
+	_Atomic uint64_t stat_cells_skipped;
+	rgb_t		palit[256];
+	prng_t		prng;		/* Seed row values. */
+	flame_row_fn	row_fn;
+	const char	*row_fn_name;
+	/* Worker pool. Band 0 is computed by flame_step() caller. */
+	flame_band_t	bands[FLAME_THREADS_MAX];
+	size_t		bands_count;
+	int		out_fmt;	/* FLAME_OUT_*. */
+	uint8_t		*out_buf;	/* Output of current step. */
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond_start;
+	pthread_cond_t	cond_done;
+	uint64_t	step_gen;	/* Incremented on each step start. */
+	size_t		working;	/* Workers not done with step. */
+	int		stop;
+	/* Producer thread and its output. */
+	uint8_t		*out_bufs[FLAME_OUT_BUFS];
+	size_t		out_rows[FLAME_OUT_BUFS]; /* Rows [out_rows, height) are zero. */
+	_Atomic uint32_t out_mid;	/* Index | FLAME_OUT_FRESH. */
+	uint32_t	out_back;	/* Owned by producer. */
+	uint32_t	out_front;	/* Owned by render thread. */
+	int		prod_running;
+	pthread_t	prod_thread;
+	/* Requests: not under workers lock, so render thread never waits
+	 * for step in progress. req_lock only guards producer sleep. */
+	pthread_mutex_t	req_lock;
+	pthread_cond_t	cond_req;
+	int		prod_stop;	/* Under req_lock. */
+	_Atomic uint64_t steps_req;	/* Steps requested by render thread. */
+	uint64_t	steps_done;	/* Owned by producer. */
+} flame_t, *flame_p;
+
+#define FLAME_ROW(__flame, __y)						\
+	(&(__flame)->heat[((__y) * (__flame)->width)])
+#define FLAME_HEAT(__flame, __x, __y)					\
+	(__flame)->heat[(((__y) * (__flame)->width) + (__x))]
+
+
+/* Returns zeroed FLAME_MEM_ALIGN aligned memory or NULL. */
+static inline void *
+flame_mem_alloc(const size_t size) {
+	void *mem;
+
+#ifdef MAP_ALIGNED_SUPER
+	mem = mmap(NULL, size, (PROT_READ | PROT_WRITE),
+	    (MAP_PRIVATE | MAP_ANON | MAP_ALIGNED_SUPER), -1, 0);
+	if (MAP_FAILED == mem)
+		return (NULL);
+#else
+	if (0 != posix_memalign(&mem, FLAME_MEM_ALIGN,
+	    roundup(size, FLAME_MEM_ALIGN)))
+		return (NULL);
+#	ifdef MADV_HUGEPAGE
+	/* Before first touch: memset() below faults in huge pages. */
+	madvise(mem, roundup(size, FLAME_MEM_ALIGN), MADV_HUGEPAGE);
+#	endif
+	memset(mem, 0x00, size);
+#endif
+
+	return (mem);
+}
+
+static inline void
+flame_mem_free(void *mem, const size_t size) {
+
+	if (NULL == mem)
+		return;
+#ifdef MAP_ALIGNED_SUPER
+	munmap(mem, size);
+#else
+	free(mem);
+	(void)size;
+#endif
+}
+
+/* Heat of cell from three cells below: (a + b + c) / 2.97 - 1.
+ * Float to int conversion wraps values above 255, as it always did on
+ * x86 and arm, so keep it to not change flame look. */
+static inline uint8_t
+flame_cell_ref(const uint32_t a, const uint32_t b, const uint32_t c) {
+	uint8_t tmp;
+
+	tmp = (uint8_t)(uint32_t)((a + b + c) / 2.97f);
+	if (tmp > 1) {
+		tmp --;
+	} else {
+		tmp = 0;
+	}
+	return (tmp);
+}
+
+static inline uint8_t
+flame_cell(const uint32_t a, const uint32_t b, const uint32_t c) {
+	uint32_t tmp;
+
+	tmp = (((a + b + c) * FLAME_DIV_MUL) >> FLAME_DIV_SHIFT);
+	tmp &= 0xff;
+	if (tmp > 1) {
+		tmp --;
+	} else {
+		tmp = 0;
+	}
+	return ((uint8_t)tmp);
+}
+
+
+/* Column 1 is computed only by first pass. */
+static inline size_t
+flame_row_first_col(const flame_rows_p rows, size_t b) {
+
+	if (1 != b)
+		return (b);
+	rows->p1_cur[1] = flame_cell(rows->p1_prev[0], rows->p1_prev[1],
+	    rows->old_prev[2]);
+	rows->old_cur[1] = rows->heat_cur[1];
+	rows->heat_cur[1] = rows->p1_cur[1];
+	return (2);
+}
+
+static inline void
+flame_row_scalar_range(const flame_rows_p rows, size_t b, size_t e) {
+	size_t i;
+	uint8_t tmp;
+
+	for (i = b; i < e; i ++) {
+		rows->p1_cur[i] = flame_cell(rows->p1_prev[(i - 1)],
+		    rows->p1_prev[i], rows->old_prev[(i + 1)]);
+		tmp = flame_cell(rows->p1_prev[(i - 1)],
+		    rows->heat_prev[i], rows->heat_prev[(i + 1)]);
+		rows->old_cur[i] = rows->heat_cur[i];
+		rows->heat_cur[i] = tmp;
+		if (NULL != rows->rgb_cur) {
+			rows->rgb_cur[i] = rows->palit[tmp];
+		} else {
+			rows->idx_cur[i] = tmp;
+		}
+	}
+}
+
+static void
+flame_row_scalar(const flame_rows_p rows, size_t b, size_t e) {
+
+	b = flame_row_first_col(rows, b);
+	flame_row_scalar_range(rows, b, e);
+}
+
+#ifdef FLAME_SIMD_X86
+/* 16 cells: (((a + b + c) * mul) >> 16) & 0xff, saturating - 1. */
+static inline __m128i
+flame_cell_sse2(const __m128i a, const __m128i b, const __m128i c) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i mul = _mm_set1_epi16((short)FLAME_DIV_MUL);
+	const __m128i mask = _mm_set1_epi16(0xff);
+	const __m128i one = _mm_set1_epi8(1);
+	__m128i lo, hi;
+
+	lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(a, zero),
+	    _mm_unpacklo_epi8(b, zero)), _mm_unpacklo_epi8(c, zero));
+	hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(a, zero),
+	    _mm_unpackhi_epi8(b, zero)), _mm_unpackhi_epi8(c, zero));
+	lo = _mm_and_si128(_mm_mulhi_epu16(lo, mul), mask);
+	hi = _mm_and_si128(_mm_mulhi_epu16(hi, mul), mask);
+
+	return (_mm_subs_epu8(_mm_packus_epi16(lo, hi), one));
+}
+
+static void
+flame_row_sse2(const flame_rows_p rows, size_t b, size_t e) {
+	size_t i, k;
+	__m128i a, p1, p2;
+
+	b = flame_row_first_col(rows, b);
+	for (i = b; (i + 16) <= e; i += 16) {
+		a = _mm_loadu_si128((const __m128i*)&rows->p1_prev[(i - 1)]);
+		p1 = flame_cell_sse2(a,
+		    _mm_loadu_si128((const __m128i*)&rows->p1_prev[i]),
+		    _mm_loadu_si128((const __m128i*)&rows->old_prev[(i + 1)]));
+		p2 = flame_cell_sse2(a,
+		    _mm_loadu_si128((const __m128i*)&rows->heat_prev[i]),
+		    _mm_loadu_si128((const __m128i*)&rows->heat_prev[(i + 1)]));
+		_mm_storeu_si128((__m128i*)&rows->p1_cur[i], p1);
+		_mm_storeu_si128((__m128i*)&rows->old_cur[i],
+		    _mm_loadu_si128((const __m128i*)&rows->heat_cur[i]));
+		_mm_storeu_si128((__m128i*)&rows->heat_cur[i], p2);
+		if (NULL == rows->rgb_cur) {
+			_mm_storeu_si128((__m128i*)&rows->idx_cur[i], p2);
+			continue;
+		}
+		/* Palette expansion while row is hot in L1. */
+		for (k = i; k < (i + 16); k ++) {
+			rows->rgb_cur[k] = rows->palit[rows->heat_cur[k]];
+		}
+	}
+	flame_row_scalar_range(rows, i, e);
+}
+#endif
+
+#ifdef FLAME_SIMD_AVX2
+__attribute__((target("avx2")))
+static inline __m256i
+flame_cell_avx2(const __m256i a, const __m256i b, const __m256i c) {
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i mul = _mm256_set1_epi16((short)FLAME_DIV_MUL);
+	const __m256i mask = _mm256_set1_epi16(0xff);
+	const __m256i one = _mm256_set1_epi8(1);
+	__m256i lo, hi;
+
+	/* Unpack/pack work inside 128 bit lanes, so order is restored
+	 * by pack. */
+	lo = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpacklo_epi8(a, zero),
+	    _mm256_unpacklo_epi8(b, zero)), _mm256_unpacklo_epi8(c, zero));
+	hi = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpackhi_epi8(a, zero),
+	    _mm256_unpackhi_epi8(b, zero)), _mm256_unpackhi_epi8(c, zero));
+	lo = _mm256_and_si256(_mm256_mulhi_epu16(lo, mul), mask);
+	hi = _mm256_and_si256(_mm256_mulhi_epu16(hi, mul), mask);
+
+	return (_mm256_subs_epu8(_mm256_packus_epi16(lo, hi), one));
+}
+
+__attribute__((target("avx2")))
+static void
+flame_row_avx2(const flame_rows_p rows, size_t b, size_t e) {
+	size_t i, k;
+	__m256i a, p1, p2;
+
+	b = flame_row_first_col(rows, b);
+	for (i = b; (i + 32) <= e; i += 32) {
+		a = _mm256_loadu_si256((const __m256i*)&rows->p1_prev[(i - 1)]);
+		p1 = flame_cell_avx2(a,
+		    _mm256_loadu_si256((const __m256i*)&rows->p1_prev[i]),
+		    _mm256_loadu_si256((const __m256i*)&rows->old_prev[(i + 1)]));
+		p2 = flame_cell_avx2(a,
+		    _mm256_loadu_si256((const __m256i*)&rows->heat_prev[i]),
+		    _mm256_loadu_si256((const __m256i*)&rows->heat_prev[(i + 1)]));
+		_mm256_storeu_si256((__m256i*)&rows->p1_cur[i], p1);
+		_mm256_storeu_si256((__m256i*)&rows->old_cur[i],
+		    _mm256_loadu_si256((const __m256i*)&rows->heat_cur[i]));
+		_mm256_storeu_si256((__m256i*)&rows->heat_cur[i], p2);
+		if (NULL == rows->rgb_cur) {
+			_mm256_storeu_si256((__m256i*)&rows->idx_cur[i], p2);
+			continue;
+		}
+		for (k = i; k < (i + 32); k ++) {
+			rows->rgb_cur[k] = rows->palit[rows->heat_cur[k]];
+		}
+	}
+	flame_row_scalar_range(rows, i, e);
+}
+#endif
+
+#ifdef FLAME_SIMD_NEON
+static inline uint8x16_t
+flame_cell_neon(const uint8x16_t a, const uint8x16_t b, const uint8x16_t c) {
+	const uint16x4_t mul = vdup_n_u16(FLAME_DIV_MUL);
+	const uint16x8_t mask = vdupq_n_u16(0xff);
+	uint16x8_t lo, hi;
+
+	lo = vaddw_u8(vaddl_u8(vget_low_u8(a), vget_low_u8(b)),
+	    vget_low_u8(c));
+	hi = vaddw_u8(vaddl_u8(vget_high_u8(a), vget_high_u8(b)),
+	    vget_high_u8(c));
+	lo = vandq_u16(vcombine_u16(
+	    vshrn_n_u32(vmull_u16(vget_low_u16(lo), mul), FLAME_DIV_SHIFT),
+	    vshrn_n_u32(vmull_u16(vget_high_u16(lo), mul), FLAME_DIV_SHIFT)),
+	    mask);
+	hi = vandq_u16(vcombine_u16(
+	    vshrn_n_u32(vmull_u16(vget_low_u16(hi), mul), FLAME_DIV_SHIFT),
+	    vshrn_n_u32(vmull_u16(vget_high_u16(hi), mul), FLAME_DIV_SHIFT)),
+	    mask);
+
+	return (vqsubq_u8(vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)),
+	    vdupq_n_u8(1)));
+}
+
+static void
+flame_row_neon(const flame_rows_p rows, size_t b, size_t e) {
+	size_t i, k;
+	uint8x16_t a, p1, p2;
+
+	b = flame_row_first_col(rows, b);
+	for (i = b; (i + 16) <= e; i += 16) {
+		a = vld1q_u8(&rows->p1_prev[(i - 1)]);
+		p1 = flame_cell_neon(a, vld1q_u8(&rows->p1_prev[i]),
+		    vld1q_u8(&rows->old_prev[(i + 1)]));
+		p2 = flame_cell_neon(a, vld1q_u8(&rows->heat_prev[i]),
+		    vld1q_u8(&rows->heat_prev[(i + 1)]));
+		vst1q_u8(&rows->p1_cur[i], p1);
+		vst1q_u8(&rows->old_cur[i], vld1q_u8(&rows->heat_cur[i]));
+		vst1q_u8(&rows->heat_cur[i], p2);
+		if (NULL == rows->rgb_cur) {
+			vst1q_u8(&rows->idx_cur[i], p2);
+			continue;
+		}
+		for (k = i; k < (i + 16); k ++) {
+			rows->rgb_cur[k] = rows->palit[rows->heat_cur[k]];
+		}
+	}
+	flame_row_scalar_range(rows, i, e);
+}
+#endif
+
+
+/* Select fastest row kernel supported by CPU. */
+static inline void
+flame_row_fn_select(flame_p flame, const int scalar_only) {
+
+	flame->row_fn = flame_row_scalar;
+	flame->row_fn_name = "scalar";
+	if (0 != scalar_only)
+		return;
+#ifdef FLAME_SIMD_X86
+	flame->row_fn = flame_row_sse2;
+	flame->row_fn_name = "sse2";
+#endif
+#ifdef FLAME_SIMD_AVX2
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		flame->row_fn = flame_row_avx2;
+		flame->row_fn_name = "avx2";
+	}
+#endif
+#ifdef FLAME_SIMD_NEON
+	flame->row_fn = flame_row_neon;
+	flame->row_fn_name = "neon";
+#endif
+}
+
+/* Filling flame palit: rgb_t[256]. */
+static inline void
+flame_palit_init(rgb_p palit) {
+	size_t i;
+
+	memset(palit, 0x00, (sizeof(rgb_t) * 256));
+	for (i = 0; i < 64; i ++) {
+		palit[i +   0].r = (uint8_t)(i * 4);
+		palit[i +  64].r = 0xff;
+		palit[i +  64].g = (uint8_t)(i * 4);
+		palit[i + 128].r = 0xff;
+		palit[i + 128].g = 0xff;
+		palit[i + 128].b = (uint8_t)(i * 4);
+		palit[i + 192].r = 0xff;
+		palit[i + 192].g = 0xff;
+		palit[i + 192].b = 0xff;
+	}
+}
+
+static inline void
+flame_cpu_relax(void) {
+
+#if defined(FLAME_SIMD_X86)
+	_mm_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+/* Wait until band complete rows_done rows. */
+static inline void
+flame_band_wait(flame_band_p band, const size_t rows_done) {
+	size_t spins;
+
+	for (spins = 0;
+	    atomic_load_explicit(&band->rows_done, memory_order_acquire) < rows_done;
+	    spins ++) {
+		if (FLAME_BAND_SPINS > spins) {
+			flame_cpu_relax();
+		} else {
+			sched_yield();
+		}
+	}
+}
+
+/* Returns non zero if any cell of row in columns [b, e) is not zero. */
+static inline int
+flame_row_is_hot(const flame_rows_p rows, size_t b, const size_t e) {
+	uint64_t acc = 0, p1, heat;
+
+	/* Word at a time: byte loop is not vectorized at -O2. */
+	for (; (b + sizeof(uint64_t)) <= e; b += sizeof(uint64_t)) {
+		memcpy(&p1, &rows->p1_cur[b], sizeof(uint64_t));
+		memcpy(&heat, &rows->heat_cur[b], sizeof(uint64_t));
+		acc |= (p1 | heat);
+	}
+	for (; b < e; b ++) {
+		acc |= (rows->p1_cur[b] | rows->heat_cur[b]);
+	}
+
+	return (0 != acc);
+}
+
+/* Returns non zero if row j is cold in all bands in current step. */
+static inline int
+flame_row_is_cold(flame_p flame, const size_t j) {
+	size_t i;
+
+	for (i = 0; i < flame->bands_count; i ++) {
+		flame_band_wait(&flame->bands[i], j);
+	}
+
+	return (flame->step_no != atomic_load_explicit(&flame->hot_step[j],
+	    memory_order_relaxed));
+}
+
+/* Bottom to top sweep of one band.
+ * Sweep ends at first row j that cannot get heat: row (j - 1) is cold
+ * in all bands and was cold before step, so all rows above stay zero.
+ * All bands see same rows, so all stop at same j. */
+static inline void
+flame_band_step(flame_band_p band) {
+	size_t j;
+	int hot = 1;
+	flame_p flame = band->flame;
+	flame_band_p left = NULL, right = NULL;
+	flame_rows_t rows;
+	const size_t idx = (size_t)(band - flame->bands);
+
+	if (0 < idx) {
+		left = (band - 1);
+	}
+	if ((idx + 1) < flame->bands_count) {
+		right = (band + 1);
+	}
+	rows.palit = flame->palit;
+	rows.p1_prev = FLAME_ROW(flame, 0);
+	rows.old_prev = FLAME_ROW(flame, 0);
+	rows.heat_prev = FLAME_ROW(flame, 0);
+	for (j = 1; j < (flame->height - 1); j ++) {
+		if (0 == hot && j > flame->rows_hot &&
+		    0 != flame_row_is_cold(flame, (j - 1)))
+			break;
+		/* Edge columns of row (j - 1) are computed by neighbours. */
+		if (NULL != left) {
+			flame_band_wait(left, (j - 1));
+		}
+		if (NULL != right) {
+			flame_band_wait(right, (j - 1));
+		}
+		rows.p1_cur = flame->p1_rows[(j % 3)];
+		rows.old_cur = flame->old_rows[(j % 3)];
+		rows.heat_cur = FLAME_ROW(flame, j);
+		if (FLAME_OUT_RGB == flame->out_fmt) {
+			rows.rgb_cur = &((rgb_p)flame->out_buf)[(j * flame->width)];
+			rows.idx_cur = NULL;
+		} else {
+			rows.rgb_cur = NULL;
+			rows.idx_cur = &flame->out_buf[(j * flame->width)];
+		}
+		flame->row_fn(&rows, band->b, band->e);
+		/* Only rows from previous top can stop sweep. */
+		hot = ((j < flame->rows_hot) ||
+		    flame_row_is_hot(&rows, band->b, band->e));
+		if (0 != hot) {
+			atomic_store_explicit(&flame->hot_step[j],
+			    flame->step_no, memory_order_relaxed);
+		}
+		atomic_store_explicit(&band->rows_done, j,
+		    memory_order_release);
+		rows.p1_prev = rows.p1_cur;
+		rows.old_prev = rows.old_cur;
+		rows.heat_prev = rows.heat_cur;
+	}
+	band->rows_top = j;
+	/* Release neighbours waiting for not computed rows. */
+	atomic_store_explicit(&band->rows_done, flame->height,
+	    memory_order_release);
+}
+
+static void *
+flame_worker_proc(void *arg) {
+	flame_band_p band = arg;
+	flame_p flame = band->flame;
+	uint64_t step_gen = 0; /* Workers are started before first step. */
+
+	pthread_mutex_lock(&flame->lock);
+	for (;;) {
+		while (0 == flame->stop && step_gen == flame->step_gen) {
+			pthread_cond_wait(&flame->cond_start, &flame->lock);
+		}
+		if (0 != flame->stop)
+			break;
+		step_gen = flame->step_gen;
+		pthread_mutex_unlock(&flame->lock);
+
+		flame_band_step(band);
+
+		pthread_mutex_lock(&flame->lock);
+		flame->working --;
+		if (0 == flame->working) {
+			pthread_cond_signal(&flame->cond_done);
+		}
+	}
+	pthread_mutex_unlock(&flame->lock);
+
+	return (NULL);
+}
+
+/* width x height grid, threads: 0 - one per online CPU,
+ * seed: seed row PRNG seed.
+ * Returns 0 on success. */
+static inline int
+flame_init(flame_p flame, const size_t width, const size_t height,
+    size_t threads, const int scalar_only, const uint64_t seed) {
+	int error;
+	size_t i, threads_req = threads;
+	long ncpu;
+
+	if (NULL == flame ||
+	    FLAME_SIZE_MIN > width || FLAME_SIZE_MAX < width ||
+	    FLAME_SIZE_MIN > height || FLAME_SIZE_MAX < height)
+		return (EINVAL);
+	memset(flame, 0x00, sizeof(flame_t));
+	flame->width = width;
+	flame->height = height;
+	flame->heat = flame_mem_alloc(height * width);
+	flame->p1_rows[0] = calloc(6, width);
+	flame->hot_step = calloc(height, sizeof(uint64_t));
+	if (NULL == flame->heat || NULL == flame->p1_rows[0] ||
+	    NULL == flame->hot_step) {
+		flame_mem_free(flame->heat, (height * width));
+		free(flame->p1_rows[0]);
+		free(flame->hot_step);
+		return (ENOMEM);
+	}
+	flame->rows_hot = 1; /* Seed row only. */
+	for (i = 0; i < 3; i ++) {
+		flame->p1_rows[i] = &flame->p1_rows[0][(i * width)];
+		flame->old_rows[i] = &flame->p1_rows[0][((i + 3) * width)];
+	}
+	flame_palit_init(flame->palit);
+	prng_init(&flame->prng, seed);
+	flame_row_fn_select(flame, scalar_only);
+
+	if (0 == threads) {
+		ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = ((0 < ncpu) ? (size_t)ncpu : 1);
+	}
+	threads = MIN(threads, FLAME_THREADS_MAX);
+	threads = MIN(threads, ((width - 2) / FLAME_BAND_MIN_WIDTH));
+	threads = MAX(threads, 1);
+	if (0 != threads_req && threads_req != threads) {
+		fprintf(stderr, "flame: %zu threads requested, %zu used: "
+		    "grid is %zu columns wide.\n", threads_req, threads,
+		    width);
+	}
+
+	/* Split columns [1, width - 1). */
+	for (i = 0; i < threads; i ++) {
+		flame->bands[i].flame = flame;
+		flame->bands[i].b = ((0 == i) ? 1 : flame->bands[(i - 1)].e);
+		flame->bands[i].e = roundup((((i + 1) * width) / threads),
+		    FLAME_BAND_ALIGN);
+	}
+	flame->bands[(threads - 1)].e = (width - 1);
+
+	pthread_mutex_init(&flame->lock, NULL);
+	pthread_cond_init(&flame->cond_start, NULL);
+	pthread_cond_init(&flame->cond_done, NULL);
+	pthread_mutex_init(&flame->req_lock, NULL);
+	pthread_cond_init(&flame->cond_req, NULL);
+	flame->bands_count = 1;
+	for (i = 1; i < threads; i ++) {
+		error = pthread_create(&flame->bands[i].thread, NULL,
+		    flame_worker_proc, &flame->bands[i]);
+		if (0 != error) {
+			fprintf(stderr, "flame: pthread_create() failed: %i.\n",
+			    error);
+			/* Reshape to already started workers. */
+			flame->bands[(flame->bands_count - 1)].e =
+			    (width - 1);
+			break;
+		}
+		flame->bands_count ++;
+	}
+
+	return (0);
+}
+
+/* Flame seeds. */
+static inline void
+flame_seed(flame_p flame) {
+	size_t i;
+	uint8_t seeds[howmany(FLAME_SIZE_MAX, FLAME_SEED_GROUP)];
+
+	prng_fill(&flame->prng, seeds,
+	    howmany(flame->width, FLAME_SEED_GROUP));
+	for (i = 0; i < flame->width; i += FLAME_SEED_GROUP) {
+		memset(&FLAME_HEAT(flame, i, 0), seeds[(i / FLAME_SEED_GROUP)],
+		    MIN(FLAME_SEED_GROUP, (flame->width - i)));
+	}
+}
+
+/* Two pass flame gen method, reference implementation.
+ * Pass 1 goes left to right, pass 2 goes right to left, both bottom to
+ * top, so: pass 1 sees pass 1 values on the left and old values on the
+ * right, pass 2 sees pass 1 values on the left and pass 2 values on the
+ * right. */
+static inline void
+flame_step_ref(flame_p flame, rgb_p rgb_buf) {
+	size_t i, j;
+
+	for (i = 1; i < (flame->width - 1); i ++) {
+		for (j = 1; j < (flame->height - 1); j ++) {
+			FLAME_HEAT(flame, i, j) = flame_cell_ref(
+			    FLAME_HEAT(flame, (i - 1), (j - 1)),
+			    FLAME_HEAT(flame, i, (j - 1)),
+			    FLAME_HEAT(flame, (i + 1), (j - 1)));
+		}
+	}
+	for (i = (flame->width - 2); i > 1; i --) {
+		for (j = 1; j < (flame->height - 1); j ++) {
+			FLAME_HEAT(flame, i, j) = flame_cell_ref(
+			    FLAME_HEAT(flame, (i - 1), (j - 1)),
+			    FLAME_HEAT(flame, i, (j - 1)),
+			    FLAME_HEAT(flame, (i + 1), (j - 1)));
+			rgb_buf[((j * flame->width) + i)] =
+			    flame->palit[FLAME_HEAT(flame, i, j)];
+		}
+	}
+}
+
+/* Same as flame_step_ref(), but both passes are fused into one bottom to
+ * top sweep: row j needs only row (j - 1) of each pass, so each row
+ * vectorizes over columns and column bands run in parallel.
+ * out_buf format is flame->out_fmt. */
+static inline void
+flame_step(flame_p flame, void *out_buf) {
+	size_t i, rows_top;
+
+	for (i = 0; i < flame->bands_count; i ++) {
+		atomic_store_explicit(&flame->bands[i].rows_done, 0,
+		    memory_order_relaxed);
+	}
+	flame->out_buf = out_buf;
+	flame->step_no ++;
+	if (1 < flame->bands_count) {
+		pthread_mutex_lock(&flame->lock);
+		flame->working = (flame->bands_count - 1);
+		flame->step_gen ++;
+		pthread_cond_broadcast(&flame->cond_start);
+		pthread_mutex_unlock(&flame->lock);
+	}
+
+	flame_band_step(&flame->bands[0]);
+
+	if (1 < flame->bands_count) {
+		pthread_mutex_lock(&flame->lock);
+		while (0 != flame->working) {
+			pthread_cond_wait(&flame->cond_done, &flame->lock);
+		}
+		pthread_mutex_unlock(&flame->lock);
+	}
+
+	rows_top = flame->bands[0].rows_top;
+	flame->rows_hot = rows_top;
+	atomic_fetch_add_explicit(&flame->stat_cells,
+	    ((flame->height - 2) * (flame->width - 2)), memory_order_relaxed);
+	atomic_fetch_add_explicit(&flame->stat_cells_skipped,
+	    ((flame->height - 1 - rows_top) * (flame->width - 2)),
+	    memory_order_relaxed);
+}
+
+static inline void
+flame_update(flame_p flame, void *out_buf) {
+
+	flame_seed(flame);
+	flame_step(flame, out_buf);
+}
+
+
+/* Returns size of one output row. */
+static inline size_t
+flame_out_row_size(const flame_p flame) {
+
+	return (flame->width *
+	    ((FLAME_OUT_RGB == flame->out_fmt) ? sizeof(rgb_t) : 1));
+}
+
+/* Returns size of one output buffer. */
+static inline size_t
+flame_out_size(const flame_p flame) {
+
+	return (flame_out_row_size(flame) * flame->height);
+}
+
+/* Producer thread: runs requested steps, only last one of a batch is
+ * published. */
+static void *
+flame_producer_proc(void *arg) {
+	flame_p flame = arg;
+	uint32_t prev;
+	uint64_t i, steps, steps_req;
+	size_t rows;
+	uint8_t *out;
+	int stop;
+
+	for (;;) {
+		pthread_mutex_lock(&flame->req_lock);
+		for (;;) {
+			stop = flame->prod_stop;
+			steps_req = atomic_load_explicit(&flame->steps_req,
+			    memory_order_relaxed);
+			if (0 != stop || flame->steps_done != steps_req)
+				break;
+			pthread_cond_wait(&flame->cond_req, &flame->req_lock);
+		}
+		pthread_mutex_unlock(&flame->req_lock);
+		if (0 != stop)
+			break;
+		steps = MIN((steps_req - flame->steps_done),
+		    FLAME_PROD_STEPS_MAX);
+		flame->steps_done = steps_req;
+
+		for (i = 0; i < steps; i ++) {
+			flame_update(flame, flame->out_bufs[flame->out_back]);
+			/* Clear rows not written in this step. */
+			out = flame->out_bufs[flame->out_back];
+			rows = flame->out_rows[flame->out_back];
+			if (flame->rows_hot < rows) {
+				memset(&out[(flame_out_row_size(flame) *
+				    flame->rows_hot)], 0x00,
+				    (flame_out_row_size(flame) *
+				    (rows - flame->rows_hot)));
+			}
+			flame->out_rows[flame->out_back] = flame->rows_hot;
+		}
+		/* Publish: swap back buffer with middle one. */
+		prev = atomic_exchange_explicit(&flame->out_mid,
+		    (flame->out_back | FLAME_OUT_FRESH), memory_order_acq_rel);
+		flame->out_back = (prev & FLAME_OUT_IDX_MASK);
+	}
+
+	return (NULL);
+}
+
+/* Allocates output buffers in out_fmt (FLAME_OUT_*) and starts
+ * producer thread.
+ * Returns 0 on success. */
+static inline int
+flame_producer_start(flame_p flame, const int out_fmt) {
+	int error;
+	size_t i;
+
+	if (NULL == flame || 0 == flame->bands_count ||
+	    0 != flame->prod_running ||
+	    (FLAME_OUT_RGB != out_fmt && FLAME_OUT_INDEX != out_fmt))
+		return (EINVAL);
+	flame->out_fmt = out_fmt;
+	for (i = 0; i < FLAME_OUT_BUFS; i ++) {
+		flame->out_bufs[i] = flame_mem_alloc(flame_out_size(flame));
+		if (NULL == flame->out_bufs[i])
+			return (ENOMEM);
+		flame->out_rows[i] = flame->height; /* Not initialized. */
+	}
+	flame->out_front = 0;
+	atomic_store(&flame->out_mid, 1);
+	flame->out_back = 2;
+	error = pthread_create(&flame->prod_thread, NULL,
+	    flame_producer_proc, flame);
+	if (0 != error)
+		return (error);
+	flame->prod_running = 1;
+
+	return (0);
+}
+
+/* Asks producer thread for steps more simulation steps, never waits
+ * for step in progress: req_lock is held by producer only to check
+ * requests before sleep. */
+static inline void
+flame_producer_request(flame_p flame, const size_t steps) {
+
+	if (0 == steps)
+		return;
+	atomic_fetch_add_explicit(&flame->steps_req, steps,
+	    memory_order_relaxed);
+	/* Producer may be between check and sleep: lock to not lose
+	 * wakeup. */
+	pthread_mutex_lock(&flame->req_lock);
+	pthread_cond_signal(&flame->cond_req);
+	pthread_mutex_unlock(&flame->req_lock);
+}
+
+/* Returns newest complete output buffer, format set by
+ * flame_producer_start(), or NULL if there is no new one since last call.
+ * It stays valid and unchanged until next call.
+ * rows: rows [rows, height) of output are zero. */
+static inline const void *
+flame_producer_front(flame_p flame, size_t *rows) {
+	uint32_t prev;
+
+	if (0 == (FLAME_OUT_FRESH & atomic_load_explicit(&flame->out_mid,
+	    memory_order_relaxed)))
+		return (NULL);
+	prev = atomic_exchange_explicit(&flame->out_mid,
+	    flame->out_front, memory_order_acq_rel);
+	flame->out_front = (prev & FLAME_OUT_IDX_MASK);
+	if (NULL != rows) {
+		(*rows) = flame->out_rows[flame->out_front];
+	}
+
+	return (flame->out_bufs[flame->out_front]);
+}
+
+static inline void
+flame_destroy(flame_p flame) {
+	size_t i;
+
+	if (NULL == flame || 0 == flame->bands_count)
+		return;
+	/* Producer first: it may be waiting for workers in flame_step(). */
+	pthread_mutex_lock(&flame->req_lock);
+	flame->prod_stop = 1;
+	pthread_cond_broadcast(&flame->cond_req);
+	pthread_mutex_unlock(&flame->req_lock);
+	if (0 != flame->prod_running) {
+		pthread_join(flame->prod_thread, NULL);
+		flame->prod_running = 0;
+	}
+	pthread_mutex_lock(&flame->lock);
+	flame->stop = 1;
+	pthread_cond_broadcast(&flame->cond_start);
+	pthread_mutex_unlock(&flame->lock);
+	for (i = 0; i < FLAME_OUT_BUFS; i ++) {
+		flame_mem_free(flame->out_bufs[i], flame_out_size(flame));
+		flame->out_bufs[i] = NULL;
+	}
+	for (i = 1; i < flame->bands_count; i ++) {
+		pthread_join(flame->bands[i].thread, NULL);
+	}
+	pthread_cond_destroy(&flame->cond_req);
+	pthread_mutex_destroy(&flame->req_lock);
+	pthread_cond_destroy(&flame->cond_done);
+	pthread_cond_destroy(&flame->cond_start);
+	pthread_mutex_destroy(&flame->lock);
+	flame_mem_free(flame->heat, (flame->height * flame->width));
+	free(flame->p1_rows[0]);
+	free(flame->hot_step);
+	memset(flame, 0x00, sizeof(flame_t));
+}
+
+
+
+/* Default grid width at 16:9: odd, row ends are not on vector edges,
+ * every thread count tested must run its own band. */
+#define FLAME_SELFTEST_WIDTH	989
+#define FLAME_SELFTEST_HEIGHT	512
+/* Seed row PRNG seed: only ref one is used, its seed row is copied. */
+#define FLAME_SELFTEST_SEED	1
+
+/* Checks row kernel against reference, odd frames are checked with
+ * index output. Returns 0 on success. */
+static inline int
+flame_selftest_fn(flame_row_fn row_fn, const char *name, size_t threads) {
+	int error = 0;
+	size_t i, j, frame;
+	flame_p ref = NULL, fast = NULL;
+	rgb_p ref_rgb = NULL, fast_rgb = NULL;
+	uint8_t *fast_idx = NULL;
+	const size_t width = FLAME_SELFTEST_WIDTH;
+	const size_t height = FLAME_SELFTEST_HEIGHT;
+	const size_t rgb_size = (sizeof(rgb_t) * width * height);
+
+	ref = calloc(1, sizeof(flame_t));
+	fast = calloc(1, sizeof(flame_t));
+	ref_rgb = calloc(1, rgb_size);
+	fast_rgb = calloc(1, rgb_size);
+	fast_idx = calloc(height, width);
+	if (NULL == ref || NULL == fast ||
+	    NULL == ref_rgb || NULL == fast_rgb || NULL == fast_idx) {
+		error = ENOMEM;
+		goto err_out;
+	}
+	error = flame_init(ref, width, height, 1, 1, FLAME_SELFTEST_SEED);
+	if (0 == error) {
+		error = flame_init(fast, width, height, threads, 1,
+		    FLAME_SELFTEST_SEED);
+	}
+	if (0 == error && threads != fast->bands_count) {
+		fprintf(stderr, "flame: %s kernel, %zu threads requested, "
+		    "%zu bands run.\n", name, threads, fast->bands_count);
+		error = -1;
+	}
+	fast->row_fn = row_fn;
+	for (frame = 0; frame < 16 && 0 == error; frame ++) {
+		flame_seed(ref);
+		memcpy(FLAME_ROW(fast, 0), FLAME_ROW(ref, 0), width);
+		flame_step_ref(ref, ref_rgb);
+		fast->out_fmt = ((0 == (frame & 1)) ?
+		    FLAME_OUT_RGB : FLAME_OUT_INDEX);
+		/* Cold rows are not written. */
+		memset(fast_rgb, 0x00, rgb_size);
+		memset(fast_idx, 0x00, (width * height));
+		flame_step(fast, ((FLAME_OUT_RGB == fast->out_fmt) ?
+		    (void*)fast_rgb : (void*)fast_idx));
+		if (0 != memcmp(ref->heat, fast->heat, (width * height))) {
+			error = -1;
+		}
+		if (FLAME_OUT_RGB == fast->out_fmt) {
+			if (0 != memcmp(ref_rgb, fast_rgb, rgb_size)) {
+				error = -1;
+			}
+		} else {
+			/* Only cells written by flame_step_ref(). */
+			for (j = 1; j < (height - 1); j ++) {
+				for (i = 2; i < (width - 1); i ++) {
+					if (FLAME_HEAT(ref, i, j) ==
+					    fast_idx[((j * width) + i)])
+						continue;
+					error = -1;
+				}
+			}
+		}
+		if (0 != error) {
+			fprintf(stderr, "flame: %s kernel, %zu threads, %s output: mismatch at frame %zu.\n",
+			    name, fast->bands_count,
+			    ((FLAME_OUT_RGB == fast->out_fmt) ? "rgb" : "index"),
+			    frame);
+		}
+	}
+
+err_out:
+	flame_destroy(ref);
+	flame_destroy(fast);
+	free(ref);
+	free(fast);
+	free(ref_rgb);
+	free(fast_rgb);
+	free(fast_idx);
+
+	return (error);
+}
+
+/* Checks all fast paths supported by CPU. Returns 0 on success. */
+static inline int
+flame_selftest(void) {
+	int error;
+	uint32_t sum;
+
+	for (sum = 0; sum <= (3 * 255); sum ++) {
+		if (((sum * FLAME_DIV_MUL) >> FLAME_DIV_SHIFT) ==
+		    (uint32_t)(sum / 2.97f))
+			continue;
+		fprintf(stderr, "flame: FLAME_DIV_MUL mismatch at %u.\n", sum);
+		return (-1);
+	}
+
+	error = flame_selftest_fn(flame_row_scalar, "scalar", 1);
+	if (0 == error) { /* Odd count: bands edges not on vector edges. */
+		error = flame_selftest_fn(flame_row_scalar, "scalar", 3);
+	}
+	if (0 == error) { /* Narrowest bands default grid allows. */
+		error = flame_selftest_fn(flame_row_scalar, "scalar",
+		    ((FLAME_SELFTEST_WIDTH - 2) / FLAME_BAND_MIN_WIDTH));
+	}
+#ifdef FLAME_SIMD_X86
+	if (0 == error) {
+		error = flame_selftest_fn(flame_row_sse2, "sse2", 1);
+	}
+#endif
+#ifdef FLAME_SIMD_AVX2
+	if (0 == error && __builtin_cpu_supports("avx2")) {
+		error = flame_selftest_fn(flame_row_avx2, "avx2", 1);
+	}
+	if (0 == error && __builtin_cpu_supports("avx2")) {
+		error = flame_selftest_fn(flame_row_avx2, "avx2", 4);
+	}
+#endif
+#ifdef FLAME_SIMD_NEON
+	if (0 == error) {
+		error = flame_selftest_fn(flame_row_neon, "neon", 1);
+	}
+	if (0 == error) {
+		error = flame_selftest_fn(flame_row_neon, "neon", 4);
+	}
+#endif
+
+	return (error);
+}
+
+
+#endif /* FLAME_H */
@@ -0,0 +1,409 @@
+/*
+ *  Copyright (c) 2020-2024 Rozhuk Ivan <rozhuk.im@gmail.com>
+ *  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * File:   flame_gl.h
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ * GPU flame engine: flame simulated in fragment shaders between two
+ * heat textures, palette applied while sampling.
+ * Without GPU engine same draw path colors heat indices streamed from CPU
+ * engine: 1 byte per texel upload instead of 3.
+ * Passes and flame quad are drawn from unit quad vertex buffer, no fixed
+ * function state is used: same code works with core profile.
+ */
+
+#ifndef FLAME_GL_H
+#define FLAME_GL_H
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#include "glutils.h"
+#include "glstate.h"
+#include "gltexstream.h"
+#include "prng.h"
+#include "flame.h"
+
+
+/* Steps per simulation tick. Each step is two passes, each pass moves
+ * flame one row up. */
+#define FLAME_GL_STEPS		8
+
+
+/* Vertex attributes locations. */
+#define FLAME_GL_ATTR_POS	0
+
+static const char *flame_gl_attrs[] = {
+	"pos", NULL
+};
+
+static const GLfloat flame_gl_quad[] = {
+	0.0f, 0.0f,	1.0f, 0.0f,	1.0f, 1.0f,	0.0f, 1.0f
+};
+
+typedef struct flame_gl_s {
+	GLuint		palit_tex;	/* 256x1 palette LUT. */
+	GLuint		draw_prog;	/* Heat + palette -> color. */
+	GLint		draw_proj_loc;
+	GLint		draw_rect_loc;
+	GLint		draw_color_loc;
+	GLint		draw_z_loc;
+	GLuint		quad_vbo;	/* Unit quad: (0, 0) - (1, 1). */
+	GLuint		quad_vao;	/* 0: no VAO support. */
+	/* Heat ping-pong, GPU engine only. */
+	GLsizei		width;
+	GLsizei		height;
+	GLuint		heat_tex[2];
+	GLuint		fbo[2];
+	size_t		cur;		/* heat_tex with last state. */
+	GLuint		step_prog;
+	GLint		step_seed_loc;
+	prng_t		prng;		/* Seed row values. */
+} flame_gl_t, *flame_gl_p;
+
+
+/* Unit quad to rect at z, heat texels are mapped to quad corners. */
+static const char *flame_gl_draw_vs =
+	"uniform mat4 proj;\n"
+	"uniform vec4 rect;\n" /* Eye space x0, y0, x1, y1. */
+	"uniform float rect_z;\n"
+	"uniform vec2 size;\n"
+	"VS_IN vec2 pos;\n"
+	"VS_OUT vec2 heat_tc;\n"
+	"void main() {\n"
+	"	gl_Position = (proj * vec4(mix(rect.xy, rect.zw, pos),\n"
+	"	    rect_z, 1.0));\n"
+	"	heat_tc = (pos * (size - 1.0));\n"
+	"}\n";
+
+/* Heat texture and palette LUT to color. */
+static const char *flame_gl_draw_fs =
+	"uniform sampler2DRect heat;\n"
+	"uniform sampler2D palit;\n"
+	"uniform vec4 color;\n"
+	"FS_IN vec2 heat_tc;\n"
+	"void main() {\n"
+	"	float v = texture2DRect(heat, heat_tc).r;\n"
+	"	FRAG_COLOR = (color *\n"
+	"	    texture2D(palit, vec2(((v * 255.0 + 0.5) / 256.0), 0.5)));\n"
+	"}\n";
+
+/* Unit quad to whole viewport. */
+static const char *flame_gl_step_vs =
+	"VS_IN vec2 pos;\n"
+	"void main() {\n"
+	"	gl_Position = vec4(((pos * 2.0) - 1.0), 0.0, 1.0);\n"
+	"}\n";
+
+/* One smoothing pass, same math as flame_cell().
+ * Row 0 gets new seeds if seed >= 0, keeps old ones otherwise. */
+static const char *flame_gl_step_fs =
+	"uniform sampler2DRect heat;\n"
+	"uniform float seed;\n"
+	"uniform vec2 size;\n"
+	"float heat_get(vec2 pos) {\n"
+	"	return (floor(texture2DRect(heat, pos).r * 255.0 + 0.5));\n"
+	"}\n"
+	"void main() {\n"
+	"	vec2 pos = gl_FragCoord.xy;\n"
+	"	float v;\n"
+	"	if (pos.y < 1.0) {\n"
+	"		if (seed < 0.0) {\n"
+	"			v = heat_get(pos);\n"
+	"		} else {\n"
+	"			v = floor(256.0 * fract(43758.5453 * sin(dot(\n"
+	"			    vec2(floor(pos.x / 8.0), seed),\n"
+	"			    vec2(12.9898, 78.233)))));\n"
+	"		}\n"
+	"	} else if (pos.x < 1.0 || pos.x > (size.x - 1.0) ||\n"
+	"	    pos.y > (size.y - 1.0)) {\n"
+	"		v = 0.0;\n"
+	"	} else {\n"
+	"		v = (heat_get(pos + vec2(-1.0, -1.0)) +\n"
+	"		    heat_get(pos + vec2(0.0, -1.0)) +\n"
+	"		    heat_get(pos + vec2(1.0, -1.0)));\n"
+	"		v = max((mod(floor(v / 2.97), 256.0) - 1.0), 0.0);\n"
+	"	}\n"
+	"	FRAG_COLOR = vec4((v / 255.0));\n"
+	"}\n";
+
+
+static inline void
+flame_gl_tex_params(const GLenum target, const GLint filter) {
+
+	glTexParameteri(target, GL_TEXTURE_MIN_FILTER, filter);
+	glTexParameteri(target, GL_TEXTURE_MAG_FILTER, filter);
+	glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+/* Draws unit quad with program that binds flame_gl_attrs in use. */
+static inline void
+flame_gl_quad_draw(flame_gl_p fgl) {
+
+	if (0 != fgl->quad_vao) {
+		glBindVertexArray(fgl->quad_vao);
+	} else {
+		glBindBuffer(GL_ARRAY_BUFFER, fgl->quad_vbo);
+		glEnableVertexAttribArray(FLAME_GL_ATTR_POS);
+		glVertexAttribPointer(FLAME_GL_ATTR_POS, 2, GL_FLOAT,
+		    GL_FALSE, 0, NULL);
+	}
+	glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+	if (0 != fgl->quad_vao) {
+		glBindVertexArray(0);
+	} else {
+		glDisableVertexAttribArray(FLAME_GL_ATTR_POS);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+}
+
+static inline void
+flame_gl_destroy(flame_gl_p fgl) {
+
+	if (NULL == fgl)
+		return;
+	if (GL_CAPS(GLSL)) {
+		glDeleteProgram(fgl->draw_prog);
+		glDeleteProgram(fgl->step_prog);
+	}
+	if (0 != fgl->quad_vao) {
+		glDeleteVertexArrays(1, &fgl->quad_vao);
+	}
+	if (0 != fgl->quad_vbo) {
+		glDeleteBuffers(1, &fgl->quad_vbo);
+	}
+	gl_state_delete_textures(1, &fgl->palit_tex);
+	gl_state_delete_textures(2, fgl->heat_tex);
+	if (GL_CAPS(FBO)) {
+		glDeleteFramebuffers(2, fgl->fbo);
+	}
+	memset(fgl, 0x00, sizeof(flame_gl_t));
+}
+
+/* Uploads new palette: 768 bytes. */
+static inline void
+flame_gl_palit_set(flame_gl_p fgl, const rgb_t *palit) {
+
+	gl_state_bind_texture(GL_TEXTURE_2D, fgl->palit_tex);
+	gl_state_pixel_store(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 256, 1,
+	    GL_RGB, GL_UNSIGNED_BYTE, palit);
+	gl_state_bind_texture(GL_TEXTURE_2D, 0);
+}
+
+/* Creates palette draw path and, if gpu_engine is set, width x height
+ * GPU flame engine, seed: seed row PRNG seed.
+ * Returns 0 on success. */
+static inline int
+flame_gl_init(flame_gl_p fgl, const int gpu_engine, const size_t width,
+    const size_t height, const uint64_t seed) {
+	size_t i;
+	GLenum status;
+	rgb_t palit[256];
+	GLint heat_fmt;
+
+	if (NULL == fgl)
+		return (EINVAL);
+	memset(fgl, 0x00, sizeof(flame_gl_t));
+	if (!GL_CAPS(GLSL) || (0 != gpu_engine && !GL_CAPS(FBO)))
+		return (EOPNOTSUPP);
+	fgl->width = (GLsizei)width;
+	fgl->height = (GLsizei)height;
+	prng_init(&fgl->prng, seed);
+
+	fgl->draw_prog = gl_program_create(flame_gl_draw_vs,
+	    flame_gl_draw_fs, flame_gl_attrs);
+	if (0 == fgl->draw_prog)
+		goto err_out;
+	gl_state_use_program(fgl->draw_prog);
+	glUniform1i(glGetUniformLocation(fgl->draw_prog, "heat"), 0);
+	glUniform1i(glGetUniformLocation(fgl->draw_prog, "palit"), 1);
+	glUniform2f(glGetUniformLocation(fgl->draw_prog, "size"),
+	    (GLfloat)fgl->width, (GLfloat)fgl->height);
+	fgl->draw_proj_loc = glGetUniformLocation(fgl->draw_prog, "proj");
+	fgl->draw_rect_loc = glGetUniformLocation(fgl->draw_prog, "rect");
+	fgl->draw_color_loc = glGetUniformLocation(fgl->draw_prog, "color");
+	fgl->draw_z_loc = glGetUniformLocation(fgl->draw_prog, "rect_z");
+	gl_state_use_program(0);
+
+	glGenBuffers(1, &fgl->quad_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, fgl->quad_vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(flame_gl_quad), flame_gl_quad,
+	    GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	if (GL_CAPS(VAO)) {
+		glGenVertexArrays(1, &fgl->quad_vao);
+		glBindVertexArray(fgl->quad_vao);
+		glBindBuffer(GL_ARRAY_BUFFER, fgl->quad_vbo);
+		glEnableVertexAttribArray(FLAME_GL_ATTR_POS);
+		glVertexAttribPointer(FLAME_GL_ATTR_POS, 2, GL_FLOAT,
+		    GL_FALSE, 0, NULL);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	/* Palette LUT. */
+	flame_palit_init(palit);
+	glGenTextures(1, &fgl->palit_tex);
+	gl_state_bind_texture(GL_TEXTURE_2D, fgl->palit_tex);
+	flame_gl_tex_params(GL_TEXTURE_2D, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, 256, 1, 0,
+	    GL_RGB, GL_UNSIGNED_BYTE, NULL);
+	flame_gl_palit_set(fgl, palit);
+
+	if (0 == gpu_engine) /* Heat streamed from CPU engine. */
+		return (0);
+
+	fgl->step_prog = gl_program_create(flame_gl_step_vs,
+	    flame_gl_step_fs, flame_gl_attrs);
+	if (0 == fgl->step_prog)
+		goto err_out;
+	gl_state_use_program(fgl->step_prog);
+	glUniform1i(glGetUniformLocation(fgl->step_prog, "heat"), 0);
+	glUniform2f(glGetUniformLocation(fgl->step_prog, "size"),
+	    (GLfloat)fgl->width, (GLfloat)fgl->height);
+	fgl->step_seed_loc = glGetUniformLocation(fgl->step_prog, "seed");
+	gl_state_use_program(0);
+
+	/* Heat render targets, cleared to zero. Nearest filter: steps
+	 * must read exact texel values, not blends of neighbours. */
+	heat_fmt = (GL_CAPS(TEXTURE_RG) ? GL_R8 : GL_RGBA8);
+	glGenTextures(2, fgl->heat_tex);
+	glGenFramebuffers(2, fgl->fbo);
+	for (i = 0; i < 2; i ++) {
+		gl_state_bind_texture(GL_TEXTURE_RECTANGLE, fgl->heat_tex[i]);
+		flame_gl_tex_params(GL_TEXTURE_RECTANGLE, GL_NEAREST);
+		glTexImage2D(GL_TEXTURE_RECTANGLE, 0, heat_fmt,
+		    fgl->width, fgl->height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+		    NULL);
+		glBindFramebuffer(GL_FRAMEBUFFER, fgl->fbo[i]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+		    GL_TEXTURE_RECTANGLE, fgl->heat_tex[i], 0);
+		status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		if (GL_FRAMEBUFFER_COMPLETE != status) {
+			fprintf(stderr, "Flame framebuffer incomplete: 0x%x.\n",
+			    status);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			goto err_out;
+		}
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	gl_state_bind_texture(GL_TEXTURE_RECTANGLE, 0);
+
+	return (0);
+
+err_out:
+	flame_gl_destroy(fgl);
+
+	return (-1);
+}
+
+/* Runs steps_count simulation steps on GPU.
+ * Changes viewport, program and texture bindings. */
+static inline void
+flame_gl_step(flame_gl_p fgl, const size_t steps_count) {
+	size_t i, pass;
+
+	glViewport(0, 0, fgl->width, fgl->height);
+	gl_state_disable(GL_BLEND);
+	gl_state_disable(GL_DEPTH_TEST);
+	gl_state_use_program(fgl->step_prog);
+	gl_state_active_texture(GL_TEXTURE0);
+
+	for (i = 0; i < steps_count; i ++) {
+		for (pass = 0; pass < 2; pass ++) {
+			/* Seed row is renewed by first pass only. */
+			glUniform1f(fgl->step_seed_loc, ((0 == pass) ?
+			    (float)(prng_u32(&fgl->prng) & 0xffff) : -1.0f));
+			glBindFramebuffer(GL_FRAMEBUFFER,
+			    fgl->fbo[(fgl->cur ^ 1)]);
+			gl_state_bind_texture(GL_TEXTURE_RECTANGLE,
+			    fgl->heat_tex[fgl->cur]);
+			flame_gl_quad_draw(fgl);
+			fgl->cur ^= 1;
+		}
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	gl_state_use_program(0);
+}
+
+/* Creates texture stream for CPU engine output.
+ * Returns 0 on success. */
+static inline int
+flame_gl_stream_init(gl_tex_stream_p ts, const flame_p flame,
+    const int direct) {
+	const GLsizei width = (GLsizei)flame->width;
+	const GLsizei height = (GLsizei)flame->height;
+
+	if (FLAME_OUT_RGB == flame->out_fmt)
+		return (gl_tex_stream_init(ts, width, height,
+		    GL_RGB8, GL_RGB, GL_UNSIGNED_BYTE, sizeof(rgb_t), direct));
+	if (GL_CAPS(TEXTURE_RG))
+		return (gl_tex_stream_init(ts, width, height,
+		    GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1, direct));
+
+	return (gl_tex_stream_init(ts, width, height,
+	    GL_LUMINANCE8, GL_LUMINANCE, GL_UNSIGNED_BYTE, 1, direct));
+}
+
+/* Draws flame quad colored by palette: rect - eye space x0, y0, x1, y1
+ * at z, view is identity, proj - column major projection matrix, color
+ * multiplies palette.
+ * heat_tex - heat streamed from CPU engine, 0 for GPU engine heat.
+ * Leaves heat texture bound. */
+static inline void
+flame_gl_draw(flame_gl_p fgl, const GLuint heat_tex, const GLfloat *proj,
+    const GLfloat *rect, const GLfloat z, const GLfloat *color) {
+
+	gl_state_use_program(fgl->draw_prog);
+	glUniformMatrix4fv(fgl->draw_proj_loc, 1, GL_FALSE, proj);
+	glUniform4fv(fgl->draw_rect_loc, 1, rect);
+	glUniform1f(fgl->draw_z_loc, z);
+	glUniform4fv(fgl->draw_color_loc, 1, color);
+	gl_state_active_texture(GL_TEXTURE1);
+	gl_state_bind_texture(GL_TEXTURE_2D, fgl->palit_tex);
+	gl_state_active_texture(GL_TEXTURE0);
+	gl_state_bind_texture(GL_TEXTURE_RECTANGLE, ((0 != heat_tex) ?
+	    heat_tex : fgl->heat_tex[fgl->cur]));
+	flame_gl_quad_draw(fgl);
+	gl_state_use_program(0);
+}
+
+
+#endif /* FLAME_GL_H */
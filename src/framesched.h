@@ -0,0 +1,156 @@
+/*
+ *  Copyright (c) 2020-2024 Rozhuk Ivan <rozhuk.im@gmail.com>
+ *  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * File:   framesched.h
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ * Frame scheduler: frames start at absolute deadlines one period apart,
+ * so time spent drawing does not add to sleep time. Timer fd becomes
+ * readable at deadline: it is polled along with other input.
+ * Lateness less than period is absorbed by next frame. Frame started
+ * period or more late missed deadlines: they are counted and schedule
+ * restarts from now instead of drawing burst to catch up. Misses are
+ * logged to stderr: first one at once, then at most once per
+ * FRAME_SCHED_LOG_INTERVAL_NS with count since previous log line.
+ */
+
+#ifndef FRAMESCHED_H
+#define FRAMESCHED_H
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <sys/timerfd.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "monoclock.h"
+
+
+#define FRAME_SCHED_FPS_MAX	1000
+#define FRAME_SCHED_LOG_INTERVAL_NS	(10 * 1000000000ull)
+
+typedef struct frame_sched_s {
+	uint64_t	period_ns;	/* 0: no cap, frames are not delayed. */
+	uint64_t	deadline_ns;	/* Next frame start, CLOCK_MONOTONIC. */
+	int		timer_fd;	/* Expires at deadline_ns when armed. */
+	/* Stats. */
+	uint64_t	missed;		/* Deadlines passed without frame. */
+	uint64_t	log_missed;	/* Missed since last log line. */
+	uint64_t	log_ns;		/* Last log line time, 0: none yet. */
+} frame_sched_t, *frame_sched_p;
+
+
+static inline void
+frame_sched_destroy(frame_sched_p fs) {
+
+	if (NULL == fs)
+		return;
+	if (-1 != fs->timer_fd) {
+		close(fs->timer_fd);
+	}
+	memset(fs, 0x00, sizeof(frame_sched_t));
+	fs->timer_fd = -1;
+}
+
+/* fps: frames per second cap, 0 - no cap.
+ * Returns 0 on success. */
+static inline int
+frame_sched_init(frame_sched_p fs, const uint32_t fps) {
+
+	if (NULL == fs || FRAME_SCHED_FPS_MAX < fps)
+		return (EINVAL);
+	memset(fs, 0x00, sizeof(frame_sched_t));
+	if (0 != fps) {
+		fs->period_ns = (1000000000ull / fps);
+	}
+	fs->deadline_ns = monoclock_ns();
+	fs->timer_fd = timerfd_create(CLOCK_MONOTONIC,
+	    (TFD_NONBLOCK | TFD_CLOEXEC));
+	if (-1 == fs->timer_fd)
+		return (errno);
+
+	return (0);
+}
+
+/* Returns non zero if frame should be started now. */
+static inline int
+frame_sched_due(const frame_sched_p fs, const uint64_t now_ns) {
+
+	return (now_ns >= fs->deadline_ns);
+}
+
+/* Arms timer fd to expire at frame deadline, expiration left from
+ * previous arm is cleared.
+ * Returns 0 on success. */
+static inline int
+frame_sched_timer_arm(frame_sched_p fs) {
+	struct itimerspec its;
+
+	memset(&its, 0x00, sizeof(its));
+	its.it_value.tv_sec = (time_t)(fs->deadline_ns / 1000000000ull);
+	its.it_value.tv_nsec = (long)(fs->deadline_ns % 1000000000ull);
+	if (0 != timerfd_settime(fs->timer_fd, TFD_TIMER_ABSTIME, &its,
+	    NULL))
+		return (errno);
+
+	return (0);
+}
+
+/* Call on frame start: next deadline is set. */
+static inline void
+frame_sched_start(frame_sched_p fs, const uint64_t now_ns) {
+	uint64_t late_ns;
+
+	if (0 == fs->period_ns) {
+		fs->deadline_ns = now_ns;
+		return;
+	}
+	late_ns = ((now_ns > fs->deadline_ns) ?
+	    (now_ns - fs->deadline_ns) : 0);
+	if (late_ns >= fs->period_ns) {
+		fs->missed += (late_ns / fs->period_ns);
+		fs->log_missed += (late_ns / fs->period_ns);
+		fs->deadline_ns = now_ns;
+		if (0 == fs->log_ns ||
+		    (now_ns - fs->log_ns) >= FRAME_SCHED_LOG_INTERVAL_NS) {
+			fprintf(stderr, "Frame deadlines missed: %"PRIu64
+			    ", last frame %"PRIu64" ms late.\n",
+			    fs->log_missed, (late_ns / 1000000));
+			fs->log_missed = 0;
+			fs->log_ns = now_ns;
+		}
+	}
+	fs->deadline_ns += fs->period_ns;
+}
+
+
+#endif /* FRAMESCHED_H */
@@ -0,0 +1,395 @@
+/*
+ *  Copyright (c) 2020-2024 Rozhuk Ivan <rozhuk.im@gmail.com>
+ *  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * File:   glstate.h
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ * Client side cache of GL state: calls that set value already set are
+ * dropped. All changes of tracked state must go through it, state set
+ * directly is unknown to cache until gl_state_invalidate().
+ * Untracked values are passed to GL as is.
+ */
+
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#include "glutils.h"
+
+
+#define GL_STATE_UNKNOWN	((GLuint)~0)
+
+/* Enable bits. */
+#define GL_STATE_CAP_BLEND		0
+#define GL_STATE_CAP_DEPTH_TEST		1
+#define GL_STATE_CAP_LIGHTING		2
+#define GL_STATE_CAP_LIGHT0		3
+#define GL_STATE_CAP_COLOR_MATERIAL	4
+#define GL_STATE_CAP_NORMALIZE		5
+#define GL_STATE_CAP_LINE_SMOOTH	6
+#define GL_STATE_CAP_POLYGON_SMOOTH	7
+#define GL_STATE_CAP_MULTISAMPLE	8
+/* Texture targets are enabled per unit, only unit 0 is tracked. */
+#define GL_STATE_CAP_TEXTURE_2D		9
+#define GL_STATE_CAP_TEXTURE_RECTANGLE	10
+
+/* Texture bindings: units 0 and 1, 2D and rectangle targets. */
+#define GL_STATE_TEX_UNITS		2
+#define GL_STATE_TEX_TARGETS		2
+
+/* GL_LIGHT0 parameters. */
+#define GL_STATE_LIGHT_AMBIENT		0
+#define GL_STATE_LIGHT_DIFFUSE		1
+#define GL_STATE_LIGHT_POSITION		2
+#define GL_STATE_LIGHT_PARAMS		3
+
+/* Hints. */
+#define GL_STATE_HINT_LINE_SMOOTH	0
+#define GL_STATE_HINT_POLYGON_SMOOTH	1
+#define GL_STATE_HINT_PERSPECTIVE	2
+#define GL_STATE_HINTS			3
+
+typedef struct gl_state_s {
+	uint32_t	caps_known;	/* Bit per GL_STATE_CAP_*. */
+	uint32_t	caps_on;
+	GLuint		program;
+	GLenum		active_tex;
+	GLuint		tex[GL_STATE_TEX_UNITS][GL_STATE_TEX_TARGETS];
+	GLenum		blend_src;
+	GLenum		blend_dst;
+	GLint		unpack_alignment; /* 0: unknown. */
+	GLenum		color_material_face;
+	GLenum		color_material_mode;
+	GLenum		hint[GL_STATE_HINTS];
+	uint32_t	light_known;	/* Bit per GL_STATE_LIGHT_*. */
+	GLfloat		light[GL_STATE_LIGHT_PARAMS][4];
+	/* Stats: calls passed to GL and dropped. */
+	uint64_t	issued;
+	uint64_t	elided;
+} gl_state_t, *gl_state_p;
+
+static gl_state_t gl_state;
+
+
+/* Forgets all cached values, next set of each is issued.
+ * Must be called with new context and after state was changed
+ * directly. Stats are kept. */
+static inline void
+gl_state_invalidate(void) {
+	size_t i, j;
+
+	gl_state.caps_known = 0;
+	gl_state.caps_on = 0;
+	gl_state.program = GL_STATE_UNKNOWN;
+	gl_state.active_tex = GL_STATE_UNKNOWN;
+	for (i = 0; i < GL_STATE_TEX_UNITS; i ++) {
+		for (j = 0; j < GL_STATE_TEX_TARGETS; j ++) {
+			gl_state.tex[i][j] = GL_STATE_UNKNOWN;
+		}
+	}
+	gl_state.blend_src = GL_STATE_UNKNOWN;
+	gl_state.blend_dst = GL_STATE_UNKNOWN;
+	gl_state.unpack_alignment = 0;
+	gl_state.color_material_face = GL_STATE_UNKNOWN;
+	gl_state.color_material_mode = GL_STATE_UNKNOWN;
+	for (i = 0; i < GL_STATE_HINTS; i ++) {
+		gl_state.hint[i] = GL_STATE_UNKNOWN;
+	}
+	gl_state.light_known = 0;
+}
+
+/* Returns 1 and counts call as elided if value not changed,
+ * otherwise stores value and counts call as issued. */
+static inline int
+gl_state_elide(GLuint *cached, const GLuint val) {
+
+	if (*cached == val) {
+		gl_state.elided ++;
+		return (1);
+	}
+	*cached = val;
+	gl_state.issued ++;
+	return (0);
+}
+
+static inline size_t
+gl_state_cap_idx(const GLenum cap) {
+
+	switch (cap) {
+	case GL_BLEND:
+		return (GL_STATE_CAP_BLEND);
+	case GL_DEPTH_TEST:
+		return (GL_STATE_CAP_DEPTH_TEST);
+	case GL_LIGHTING:
+		return (GL_STATE_CAP_LIGHTING);
+	case GL_LIGHT0:
+		return (GL_STATE_CAP_LIGHT0);
+	case GL_COLOR_MATERIAL:
+		return (GL_STATE_CAP_COLOR_MATERIAL);
+	case GL_NORMALIZE:
+		return (GL_STATE_CAP_NORMALIZE);
+	case GL_LINE_SMOOTH:
+		return (GL_STATE_CAP_LINE_SMOOTH);
+	case GL_POLYGON_SMOOTH:
+		return (GL_STATE_CAP_POLYGON_SMOOTH);
+	case GL_MULTISAMPLE:
+		return (GL_STATE_CAP_MULTISAMPLE);
+	case GL_TEXTURE_2D:
+		if (GL_TEXTURE0 != gl_state.active_tex)
+			break;
+		return (GL_STATE_CAP_TEXTURE_2D);
+	case GL_TEXTURE_RECTANGLE:
+		if (GL_TEXTURE0 != gl_state.active_tex)
+			break;
+		return (GL_STATE_CAP_TEXTURE_RECTANGLE);
+	}
+
+	return ((size_t)~0);
+}
+
+static inline void
+gl_state_set(const GLenum cap, const int on) {
+	size_t idx = gl_state_cap_idx(cap);
+	uint32_t bit;
+
+	if ((size_t)~0 != idx) {
+		bit = (((uint32_t)1) << idx);
+		if (0 != (gl_state.caps_known & bit) &&
+		    (0 != on) == (0 != (gl_state.caps_on & bit))) {
+			gl_state.elided ++;
+			return;
+		}
+		gl_state.caps_known |= bit;
+		if (0 != on) {
+			gl_state.caps_on |= bit;
+		} else {
+			gl_state.caps_on &= ~bit;
+		}
+	}
+	gl_state.issued ++;
+	if (0 != on) {
+		glEnable(cap);
+	} else {
+		glDisable(cap);
+	}
+}
+
+static inline void
+gl_state_enable(const GLenum cap) {
+
+	gl_state_set(cap, 1);
+}
+
+static inline void
+gl_state_disable(const GLenum cap) {
+
+	gl_state_set(cap, 0);
+}
+
+static inline void
+gl_state_use_program(const GLuint program) {
+
+	if (0 != gl_state_elide(&gl_state.program, program))
+		return;
+	glUseProgram(program);
+}
+
+static inline void
+gl_state_active_texture(const GLenum unit) {
+
+	if (0 != gl_state_elide(&gl_state.active_tex, unit))
+		return;
+	glActiveTexture(unit);
+}
+
+/* Returns cached binding of active unit or NULL if not tracked. */
+static inline GLuint *
+gl_state_tex_binding(const GLenum target) {
+	size_t unit, idx;
+
+	unit = (size_t)(gl_state.active_tex - GL_TEXTURE0);
+	if (GL_STATE_TEX_UNITS <= unit)
+		return (NULL);
+	switch (target) {
+	case GL_TEXTURE_2D:
+		idx = 0;
+		break;
+	case GL_TEXTURE_RECTANGLE:
+		idx = 1;
+		break;
+	default:
+		return (NULL);
+	}
+
+	return (&gl_state.tex[unit][idx]);
+}
+
+static inline void
+gl_state_bind_texture(const GLenum target, const GLuint tex) {
+	GLuint *cached = gl_state_tex_binding(target);
+
+	if (NULL == cached) {
+		gl_state.issued ++;
+	} else if (0 != gl_state_elide(cached, tex)) {
+		return;
+	}
+	glBindTexture(target, tex);
+}
+
+/* Deleted textures are unbound by GL, cache must know it: name may be
+ * reused by next glGenTextures(). */
+static inline void
+gl_state_delete_textures(const GLsizei count, const GLuint *texs) {
+	size_t i, j;
+	GLsizei k;
+
+	for (k = 0; k < count; k ++) {
+		if (0 == texs[k])
+			continue;
+		for (i = 0; i < GL_STATE_TEX_UNITS; i ++) {
+			for (j = 0; j < GL_STATE_TEX_TARGETS; j ++) {
+				if (texs[k] != gl_state.tex[i][j])
+					continue;
+				gl_state.tex[i][j] = 0;
+			}
+		}
+	}
+	glDeleteTextures(count, texs);
+}
+
+static inline void
+gl_state_blend_func(const GLenum src, const GLenum dst) {
+
+	if (src == gl_state.blend_src && dst == gl_state.blend_dst) {
+		gl_state.elided ++;
+		return;
+	}
+	gl_state.blend_src = src;
+	gl_state.blend_dst = dst;
+	gl_state.issued ++;
+	glBlendFunc(src, dst);
+}
+
+static inline void
+gl_state_pixel_store(const GLenum pname, const GLint val) {
+
+	if (GL_UNPACK_ALIGNMENT == pname) {
+		if (val == gl_state.unpack_alignment) {
+			gl_state.elided ++;
+			return;
+		}
+		gl_state.unpack_alignment = val;
+	}
+	gl_state.issued ++;
+	glPixelStorei(pname, val);
+}
+
+static inline void
+gl_state_color_material(const GLenum face, const GLenum mode) {
+
+	if (face == gl_state.color_material_face &&
+	    mode == gl_state.color_material_mode) {
+		gl_state.elided ++;
+		return;
+	}
+	gl_state.color_material_face = face;
+	gl_state.color_material_mode = mode;
+	gl_state.issued ++;
+	glColorMaterial(face, mode);
+}
+
+static inline void
+gl_state_hint(const GLenum target, const GLenum mode) {
+	size_t idx;
+
+	switch (target) {
+	case GL_LINE_SMOOTH_HINT:
+		idx = GL_STATE_HINT_LINE_SMOOTH;
+		break;
+	case GL_POLYGON_SMOOTH_HINT:
+		idx = GL_STATE_HINT_POLYGON_SMOOTH;
+		break;
+	case GL_PERSPECTIVE_CORRECTION_HINT:
+		idx = GL_STATE_HINT_PERSPECTIVE;
+		break;
+	default:
+		gl_state.issued ++;
+		glHint(target, mode);
+		return;
+	}
+	if (0 != gl_state_elide(&gl_state.hint[idx], mode))
+		return;
+	glHint(target, mode);
+}
+
+/* GL_LIGHT0 only. Position is transformed by modelview matrix at call
+ * time and cached as given: it must be set with same matrix. */
+static inline void
+gl_state_light_fv(const GLenum light, const GLenum pname,
+    const GLfloat *params) {
+	size_t idx;
+	uint32_t bit;
+
+	switch (pname) {
+	case GL_AMBIENT:
+		idx = GL_STATE_LIGHT_AMBIENT;
+		break;
+	case GL_DIFFUSE:
+		idx = GL_STATE_LIGHT_DIFFUSE;
+		break;
+	case GL_POSITION:
+		idx = GL_STATE_LIGHT_POSITION;
+		break;
+	default:
+		idx = GL_STATE_LIGHT_PARAMS;
+		break;
+	}
+	if (GL_LIGHT0 == light && GL_STATE_LIGHT_PARAMS > idx) {
+		bit = (((uint32_t)1) << idx);
+		if (0 != (gl_state.light_known & bit) &&
+		    0 == memcmp(gl_state.light[idx], params,
+		    sizeof(gl_state.light[idx]))) {
+			gl_state.elided ++;
+			return;
+		}
+		gl_state.light_known |= bit;
+		memcpy(gl_state.light[idx], params,
+		    sizeof(gl_state.light[idx]));
+	}
+	gl_state.issued ++;
+	glLightfv(light, pname, params);
+}
+
+
+#endif /* GLSTATE_H */
@@ -0,0 +1,264 @@
+/*
+ *  Copyright (c) 2020-2024 Rozhuk Ivan <rozhuk.im@gmail.com>
+ *  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * File:   gltexstream.h
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ * Texture updated every frame from client memory: storage is allocated
+ * once, data goes through ring of pixel buffer objects so driver copies
+ * it to texture asynchronously.
+ */
+
+#ifndef GLTEXSTREAM_H
+#define GLTEXSTREAM_H
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#include "glutils.h"
+#include "glstate.h"
+#include "monoclock.h"
+
+
+#define GL_TEX_STREAM_RING		3
+
+/* Upload modes: direct, or best supported PBO one if PBO is asked. */
+#define GL_TEX_STREAM_DIRECT		0 /* glTexSubImage2D() from client memory. */
+#define GL_TEX_STREAM_PBO		1 /* Orphaned PBO ring. */
+#define GL_TEX_STREAM_PERSISTENT	2 /* Persistently mapped PBO + fences. */
+
+typedef struct gl_tex_stream_s {
+	GLuint		tex;		/* GL_TEXTURE_RECTANGLE. */
+	GLsizei		width;
+	GLsizei		height;
+	GLenum		fmt;
+	GLenum		type;
+	size_t		size;		/* Bytes per full upload. */
+	size_t		row_size;
+	int		mode;		/* GL_TEX_STREAM_*. */
+	size_t		cur;		/* Next ring slot. */
+	GLuint		pbo[GL_TEX_STREAM_RING]; /* Only pbo[0] if persistent. */
+	uint8_t		*map;		/* Persistent mapping, all slots. */
+	GLsync		fence[GL_TEX_STREAM_RING];
+	/* Stats: CPU time spent in uploads. */
+	uint64_t	upload_ns;
+	uint64_t	upload_count;
+	uint64_t	upload_bytes;
+	uint64_t	upload_bytes_full; /* Bytes if all rows uploaded. */
+} gl_tex_stream_t, *gl_tex_stream_p;
+
+
+static inline const char *
+gl_tex_stream_mode_str(const int mode) {
+
+	switch (mode) {
+	case GL_TEX_STREAM_PBO:
+		return ("pbo");
+	case GL_TEX_STREAM_PERSISTENT:
+		return ("persistent pbo");
+	}
+
+	return ("direct");
+}
+
+static inline void
+gl_tex_stream_destroy(gl_tex_stream_p ts) {
+	size_t i;
+
+	if (NULL == ts)
+		return;
+	if (GL_TEX_STREAM_PERSISTENT == ts->mode) {
+		for (i = 0; i < GL_TEX_STREAM_RING; i ++) {
+			glDeleteSync(ts->fence[i]);
+		}
+		if (NULL != ts->map) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ts->pbo[0]);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		}
+	}
+	if (GL_TEX_STREAM_DIRECT != ts->mode) {
+		glDeleteBuffers(GL_TEX_STREAM_RING, ts->pbo);
+	}
+	gl_state_delete_textures(1, &ts->tex);
+	memset(ts, 0x00, sizeof(gl_tex_stream_t));
+}
+
+/* Creates width x height rectangle texture with int_fmt storage, uploads
+ * are in fmt/type, bpp bytes per pixel.
+ * direct - do not use PBO.
+ * Returns 0 on success. */
+static inline int
+gl_tex_stream_init(gl_tex_stream_p ts, const GLsizei width,
+    const GLsizei height, const GLenum int_fmt, const GLenum fmt,
+    const GLenum type, const size_t bpp, const int direct) {
+	const GLbitfield map_flags = (GL_MAP_WRITE_BIT |
+	    GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+
+	if (NULL == ts || 0 == width || 0 == height || 0 == bpp)
+		return (EINVAL);
+	memset(ts, 0x00, sizeof(gl_tex_stream_t));
+	ts->width = width;
+	ts->height = height;
+	ts->fmt = fmt;
+	ts->type = type;
+	ts->row_size = ((size_t)width * bpp);
+	ts->size = (ts->row_size * (size_t)height);
+
+	glGenTextures(1, &ts->tex);
+	gl_state_bind_texture(GL_TEXTURE_RECTANGLE, ts->tex);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_WRAP_S,
+	    GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_WRAP_T,
+	    GL_CLAMP_TO_EDGE);
+	if (GL_CAPS(TEX_STORAGE)) {
+		glTexStorage2D(GL_TEXTURE_RECTANGLE, 1, int_fmt,
+		    width, height);
+	} else {
+		glTexImage2D(GL_TEXTURE_RECTANGLE, 0, (GLint)int_fmt,
+		    width, height, 0, fmt, type, NULL);
+	}
+	gl_state_bind_texture(GL_TEXTURE_RECTANGLE, 0);
+	if (0 != direct || !GL_CAPS(PBO))
+		return (0);
+
+	if (GL_CAPS(BUF_STORAGE)) {
+		glGenBuffers(1, &ts->pbo[0]);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ts->pbo[0]);
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER,
+		    (GLsizeiptr)(ts->size * GL_TEX_STREAM_RING), NULL,
+		    map_flags);
+		ts->map = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0,
+		    (GLsizeiptr)(ts->size * GL_TEX_STREAM_RING), map_flags);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		if (NULL != ts->map) {
+			ts->mode = GL_TEX_STREAM_PERSISTENT;
+			return (0);
+		}
+		/* Fallback to orphaning. */
+		glDeleteBuffers(1, &ts->pbo[0]);
+	}
+	glGenBuffers(GL_TEX_STREAM_RING, ts->pbo);
+	ts->mode = GL_TEX_STREAM_PBO;
+
+	return (0);
+}
+
+/* Copies first rows rows from data to texture, other rows keep old
+ * content. data may be reused just after return, texture is updated
+ * before next command that reads it.
+ * Texture is left bound. */
+static inline void
+gl_tex_stream_upload(gl_tex_stream_p ts, const void *data, size_t rows) {
+	uint64_t start = monoclock_ns();
+	const void *src = data;
+	void *dst;
+	size_t size;
+	size_t i, slot;
+	int mode = ts->mode;
+	GLenum wait;
+
+	gl_state_bind_texture(GL_TEXTURE_RECTANGLE, ts->tex);
+	ts->upload_bytes_full += ts->size;
+	rows = MIN(rows, (size_t)ts->height);
+	if (0 == rows)
+		return;
+	size = (ts->row_size * rows);
+	gl_state_pixel_store(GL_UNPACK_ALIGNMENT, 1);
+	switch (mode) {
+	case GL_TEX_STREAM_PBO:
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ts->pbo[ts->cur]);
+		/* Orphan: driver gives new storage if old one in use. */
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)size,
+		    NULL, GL_STREAM_DRAW);
+		dst = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+		if (NULL == dst) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			mode = GL_TEX_STREAM_DIRECT;
+			break;
+		}
+		memcpy(dst, data, size);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		src = NULL; /* Offset in PBO. */
+		break;
+	case GL_TEX_STREAM_PERSISTENT:
+		/* Slot is free when texture copy from it done. Fences are
+		 * polled, never waited: first free slot from cur is used. */
+		for (i = 0; i < GL_TEX_STREAM_RING; i ++) {
+			slot = ((ts->cur + i) % GL_TEX_STREAM_RING);
+			if (NULL == ts->fence[slot])
+				break;
+			wait = glClientWaitSync(ts->fence[slot],
+			    GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+			if (GL_ALREADY_SIGNALED != wait &&
+			    GL_CONDITION_SATISFIED != wait)
+				continue;
+			glDeleteSync(ts->fence[slot]);
+			ts->fence[slot] = NULL;
+			break;
+		}
+		if (GL_TEX_STREAM_RING == i) {
+			/* GPU still reads all slots, or error: they are
+			 * kept with fences, this upload goes from client
+			 * memory. */
+			mode = GL_TEX_STREAM_DIRECT;
+			break;
+		}
+		ts->cur = slot;
+		memcpy(&ts->map[(ts->cur * ts->size)], data, size);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ts->pbo[0]);
+		src = (const void*)(ts->cur * ts->size);
+		break;
+	}
+	glTexSubImage2D(GL_TEXTURE_RECTANGLE, 0, 0, 0, ts->width,
+	    (GLsizei)rows, ts->fmt, ts->type, src);
+	if (GL_TEX_STREAM_DIRECT != mode) {
+		if (GL_TEX_STREAM_PERSISTENT == mode) {
+			ts->fence[ts->cur] = glFenceSync(
+			    GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		ts->cur = ((ts->cur + 1) % GL_TEX_STREAM_RING);
+	}
+
+	ts->upload_ns += (monoclock_ns() - start);
+	ts->upload_count ++;
+	ts->upload_bytes += size;
+}
+
+
+#endif /* GLTEXSTREAM_H */
@@ -0,0 +1,401 @@
+/*
+ *  Copyright (c) 2020-2024 Rozhuk Ivan <rozhuk.im@gmail.com>
+ *  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * File:   glutils.h
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ * OpenGL capabilities detection and shaders helpers.
+ */
+
+#ifndef GLUTILS_H
+#define GLUTILS_H
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <math.h>
+
+#include <GL/gl.h>
+#include <GL/glx.h>
+#include <GL/glext.h>
+
+
+#define GL_CAPS_F_GLSL		(((uint32_t)1) << 0) /* GLSL 1.20. */
+#define GL_CAPS_F_FBO		(((uint32_t)1) << 1) /* ARB_framebuffer_object. */
+#define GL_CAPS_F_TEXTURE_RG	(((uint32_t)1) << 2) /* GL_R8 textures. */
+#define GL_CAPS_F_PBO		(((uint32_t)1) << 3) /* ARB_pixel_buffer_object. */
+#define GL_CAPS_F_TEX_STORAGE	(((uint32_t)1) << 4) /* ARB_texture_storage. */
+#define GL_CAPS_F_BUF_STORAGE	(((uint32_t)1) << 5) /* ARB_buffer_storage + ARB_sync. */
+#define GL_CAPS_F_VAO		(((uint32_t)1) << 6) /* ARB_vertex_array_object. */
+#define GL_CAPS_F_INSTANCED	(((uint32_t)1) << 7) /* ARB_instanced_arrays + ARB_draw_instanced. */
+#define GL_CAPS_F_CORE		(((uint32_t)1) << 8) /* Core profile context. */
+
+typedef struct gl_caps_s {
+	int		major;
+	int		minor;
+	uint32_t	flags;
+} gl_caps_t, *gl_caps_p;
+
+static gl_caps_t gl_caps;
+
+
+#define GL_VER_GE(__major, __minor)					\
+	(gl_caps.major > (__major) ||					\
+	 (gl_caps.major == (__major) && gl_caps.minor >= (__minor)))
+
+#define GL_CAPS(__flag)	(0 != (gl_caps.flags & (GL_CAPS_F_ ## __flag)))
+
+
+/* Entry points above GL 1.3, resolved by gl_caps_init(): capabilities
+ * that use function, its type and name.
+ * Missing function clears capabilities flags. */
+#define GL_PROCS(__P)							\
+	__P(0, PFNGLGETSTRINGIPROC, glGetStringi)			\
+	/* GL 2.0: shaders. */						\
+	__P(GL_CAPS_F_GLSL, PFNGLCREATESHADERPROC, glCreateShader)	\
+	__P(GL_CAPS_F_GLSL, PFNGLDELETESHADERPROC, glDeleteShader)	\
+	__P(GL_CAPS_F_GLSL, PFNGLSHADERSOURCEPROC, glShaderSource)	\
+	__P(GL_CAPS_F_GLSL, PFNGLCOMPILESHADERPROC, glCompileShader)	\
+	__P(GL_CAPS_F_GLSL, PFNGLGETSHADERIVPROC, glGetShaderiv)	\
+	__P(GL_CAPS_F_GLSL, PFNGLGETSHADERINFOLOGPROC, glGetShaderInfoLog) \
+	__P(GL_CAPS_F_GLSL, PFNGLCREATEPROGRAMPROC, glCreateProgram)	\
+	__P(GL_CAPS_F_GLSL, PFNGLDELETEPROGRAMPROC, glDeleteProgram)	\
+	__P(GL_CAPS_F_GLSL, PFNGLATTACHSHADERPROC, glAttachShader)	\
+	__P(GL_CAPS_F_GLSL, PFNGLBINDATTRIBLOCATIONPROC, glBindAttribLocation) \
+	__P(GL_CAPS_F_GLSL, PFNGLLINKPROGRAMPROC, glLinkProgram)	\
+	__P(GL_CAPS_F_GLSL, PFNGLGETPROGRAMIVPROC, glGetProgramiv)	\
+	__P(GL_CAPS_F_GLSL, PFNGLGETPROGRAMINFOLOGPROC, glGetProgramInfoLog) \
+	__P(GL_CAPS_F_GLSL, PFNGLUSEPROGRAMPROC, glUseProgram)		\
+	__P(GL_CAPS_F_GLSL, PFNGLGETUNIFORMLOCATIONPROC, glGetUniformLocation) \
+	__P(GL_CAPS_F_GLSL, PFNGLUNIFORM1IPROC, glUniform1i)		\
+	__P(GL_CAPS_F_GLSL, PFNGLUNIFORM1FPROC, glUniform1f)		\
+	__P(GL_CAPS_F_GLSL, PFNGLUNIFORM2FPROC, glUniform2f)		\
+	__P(GL_CAPS_F_GLSL, PFNGLUNIFORM2FVPROC, glUniform2fv)		\
+	__P(GL_CAPS_F_GLSL, PFNGLUNIFORM3FVPROC, glUniform3fv)		\
+	__P(GL_CAPS_F_GLSL, PFNGLUNIFORM4FVPROC, glUniform4fv)		\
+	__P(GL_CAPS_F_GLSL, PFNGLUNIFORMMATRIX4FVPROC, glUniformMatrix4fv) \
+	__P(GL_CAPS_F_GLSL, PFNGLVERTEXATTRIB2FVPROC, glVertexAttrib2fv) \
+	__P(GL_CAPS_F_GLSL, PFNGLVERTEXATTRIB3FVPROC, glVertexAttrib3fv) \
+	__P(GL_CAPS_F_GLSL, PFNGLVERTEXATTRIB4FVPROC, glVertexAttrib4fv) \
+	__P(GL_CAPS_F_GLSL, PFNGLVERTEXATTRIBPOINTERPROC,		\
+	    glVertexAttribPointer)					\
+	__P(GL_CAPS_F_GLSL, PFNGLENABLEVERTEXATTRIBARRAYPROC,		\
+	    glEnableVertexAttribArray)					\
+	__P(GL_CAPS_F_GLSL, PFNGLDISABLEVERTEXATTRIBARRAYPROC,		\
+	    glDisableVertexAttribArray)					\
+	/* GL 1.5: buffer objects, meshes and PBO. */			\
+	__P((GL_CAPS_F_GLSL | GL_CAPS_F_PBO), PFNGLGENBUFFERSPROC,	\
+	    glGenBuffers)						\
+	__P((GL_CAPS_F_GLSL | GL_CAPS_F_PBO), PFNGLDELETEBUFFERSPROC,	\
+	    glDeleteBuffers)						\
+	__P((GL_CAPS_F_GLSL | GL_CAPS_F_PBO), PFNGLBINDBUFFERPROC,	\
+	    glBindBuffer)						\
+	__P((GL_CAPS_F_GLSL | GL_CAPS_F_PBO), PFNGLBUFFERDATAPROC,	\
+	    glBufferData)						\
+	__P((GL_CAPS_F_GLSL | GL_CAPS_F_PBO), PFNGLBUFFERSUBDATAPROC,	\
+	    glBufferSubData)						\
+	__P(GL_CAPS_F_PBO, PFNGLMAPBUFFERPROC, glMapBuffer)		\
+	__P(GL_CAPS_F_PBO, PFNGLUNMAPBUFFERPROC, glUnmapBuffer)		\
+	/* ARB_framebuffer_object. */					\
+	__P(GL_CAPS_F_FBO, PFNGLGENFRAMEBUFFERSPROC, glGenFramebuffers)	\
+	__P(GL_CAPS_F_FBO, PFNGLDELETEFRAMEBUFFERSPROC,		\
+	    glDeleteFramebuffers)					\
+	__P(GL_CAPS_F_FBO, PFNGLBINDFRAMEBUFFERPROC, glBindFramebuffer)	\
+	__P(GL_CAPS_F_FBO, PFNGLFRAMEBUFFERTEXTURE2DPROC,		\
+	    glFramebufferTexture2D)					\
+	__P(GL_CAPS_F_FBO, PFNGLCHECKFRAMEBUFFERSTATUSPROC,		\
+	    glCheckFramebufferStatus)					\
+	__P(GL_CAPS_F_FBO, PFNGLGENRENDERBUFFERSPROC, glGenRenderbuffers) \
+	__P(GL_CAPS_F_FBO, PFNGLDELETERENDERBUFFERSPROC,		\
+	    glDeleteRenderbuffers)					\
+	__P(GL_CAPS_F_FBO, PFNGLBINDRENDERBUFFERPROC, glBindRenderbuffer) \
+	__P(GL_CAPS_F_FBO, PFNGLRENDERBUFFERSTORAGEPROC,		\
+	    glRenderbufferStorage)					\
+	__P(GL_CAPS_F_FBO, PFNGLFRAMEBUFFERRENDERBUFFERPROC,		\
+	    glFramebufferRenderbuffer)					\
+	/* ARB_texture_storage. */					\
+	__P(GL_CAPS_F_TEX_STORAGE, PFNGLTEXSTORAGE2DPROC, glTexStorage2D) \
+	/* ARB_buffer_storage + ARB_sync. */				\
+	__P(GL_CAPS_F_BUF_STORAGE, PFNGLBUFFERSTORAGEPROC, glBufferStorage) \
+	__P(GL_CAPS_F_BUF_STORAGE, PFNGLMAPBUFFERRANGEPROC, glMapBufferRange) \
+	__P(GL_CAPS_F_BUF_STORAGE, PFNGLFENCESYNCPROC, glFenceSync)	\
+	__P(GL_CAPS_F_BUF_STORAGE, PFNGLCLIENTWAITSYNCPROC, glClientWaitSync) \
+	__P(GL_CAPS_F_BUF_STORAGE, PFNGLDELETESYNCPROC, glDeleteSync)	\
+	/* ARB_vertex_array_object. */					\
+	__P(GL_CAPS_F_VAO, PFNGLGENVERTEXARRAYSPROC, glGenVertexArrays)	\
+	__P(GL_CAPS_F_VAO, PFNGLDELETEVERTEXARRAYSPROC,		\
+	    glDeleteVertexArrays)					\
+	__P(GL_CAPS_F_VAO, PFNGLBINDVERTEXARRAYPROC, glBindVertexArray)	\
+	/* ARB_instanced_arrays + ARB_draw_instanced. */		\
+	__P(GL_CAPS_F_INSTANCED, PFNGLVERTEXATTRIBDIVISORPROC,		\
+	    glVertexAttribDivisor)					\
+	__P(GL_CAPS_F_INSTANCED, PFNGLDRAWELEMENTSINSTANCEDPROC,	\
+	    glDrawElementsInstanced)
+
+/* Pointers named as functions: callers do not care about resolving.
+ * Do not define GL_GLEXT_PROTOTYPES, it declares same names. */
+#define GL_PROC_DECL(__caps, __type, __name)				\
+	static __type __name = NULL;
+GL_PROCS(GL_PROC_DECL)
+#undef GL_PROC_DECL
+
+
+/* Returns non zero if extension supported by current context.
+ * Context version must be in gl_caps. */
+static inline int
+gl_ext_supported(const char *name) {
+	const char *exts, *pos;
+	size_t name_size;
+	GLint i, count = 0;
+
+	if (NULL == name)
+		return (0);
+	if (GL_VER_GE(3, 0)) {
+		/* Core profile has no GL_EXTENSIONS string. */
+		if (NULL == glGetStringi)
+			return (0);
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (i = 0; i < count; i ++) {
+			exts = (const char*)glGetStringi(GL_EXTENSIONS,
+			    (GLuint)i);
+			if (NULL != exts && 0 == strcmp(exts, name))
+				return (1);
+		}
+		return (0);
+	}
+	exts = (const char*)glGetString(GL_EXTENSIONS);
+	if (NULL == exts)
+		return (0);
+	name_size = strlen(name);
+	for (pos = exts; NULL != (pos = strstr(pos, name)); pos += name_size) {
+		if ((pos == exts || ' ' == pos[-1]) &&
+		    (' ' == pos[name_size] || 0 == pos[name_size]))
+			return (1);
+	}
+
+	return (0);
+}
+
+/* Returns function address, ARB suffixed name is tried if core name
+ * not found. */
+static inline __GLXextFuncPtr
+gl_proc_get(const char *name) {
+	__GLXextFuncPtr proc;
+	char name_arb[64];
+
+	proc = glXGetProcAddress((const GLubyte*)name);
+	if (NULL != proc)
+		return (proc);
+	snprintf(name_arb, sizeof(name_arb), "%sARB", name);
+
+	return (glXGetProcAddress((const GLubyte*)name_arb));
+}
+
+/* Must be called with current context. */
+static inline void
+gl_caps_init(void) {
+	const char *ver;
+	GLint profile = 0;
+
+	memset(&gl_caps, 0x00, sizeof(gl_caps));
+#define GL_PROC_RESOLVE(__caps, __type, __name)				\
+	__name = (__type)gl_proc_get(#__name);
+	GL_PROCS(GL_PROC_RESOLVE)
+#undef GL_PROC_RESOLVE
+	ver = (const char*)glGetString(GL_VERSION);
+	if (NULL == ver ||
+	    2 != sscanf(ver, "%d.%d", &gl_caps.major, &gl_caps.minor)) {
+		gl_caps.major = 1;
+		gl_caps.minor = 1;
+	}
+	if (GL_VER_GE(2, 1)) {
+		gl_caps.flags |= GL_CAPS_F_GLSL;
+	}
+	if (GL_VER_GE(3, 2)) {
+		glGetIntegerv(GL_CONTEXT_PROFILE_MASK, &profile);
+		if (0 != (GL_CONTEXT_CORE_PROFILE_BIT & profile)) {
+			gl_caps.flags |= GL_CAPS_F_CORE;
+		}
+	}
+	if (GL_VER_GE(3, 0) ||
+	    gl_ext_supported("GL_ARB_framebuffer_object")) {
+		gl_caps.flags |= GL_CAPS_F_FBO;
+	}
+	if (GL_VER_GE(3, 0) ||
+	    gl_ext_supported("GL_ARB_texture_rg")) {
+		gl_caps.flags |= GL_CAPS_F_TEXTURE_RG;
+	}
+	if (GL_VER_GE(2, 1) ||
+	    gl_ext_supported("GL_ARB_pixel_buffer_object")) {
+		gl_caps.flags |= GL_CAPS_F_PBO;
+	}
+	if (GL_VER_GE(4, 2) ||
+	    gl_ext_supported("GL_ARB_texture_storage")) {
+		gl_caps.flags |= GL_CAPS_F_TEX_STORAGE;
+	}
+	if (GL_VER_GE(4, 4) ||
+	    (gl_ext_supported("GL_ARB_buffer_storage") &&
+	     (GL_VER_GE(3, 2) || gl_ext_supported("GL_ARB_sync")))) {
+		gl_caps.flags |= GL_CAPS_F_BUF_STORAGE;
+	}
+	if (GL_VER_GE(3, 0) ||
+	    gl_ext_supported("GL_ARB_vertex_array_object")) {
+		gl_caps.flags |= GL_CAPS_F_VAO;
+	}
+	if (GL_VER_GE(3, 3) ||
+	    (gl_ext_supported("GL_ARB_instanced_arrays") &&
+	     gl_ext_supported("GL_ARB_draw_instanced"))) {
+		gl_caps.flags |= GL_CAPS_F_INSTANCED;
+	}
+	/* Context claims capability but driver does not export all
+	 * its functions. */
+#define GL_PROC_CHECK(__caps, __type, __name)				\
+	if (NULL == __name) {						\
+		gl_caps.flags &= ~((uint32_t)(__caps));			\
+	}
+	GL_PROCS(GL_PROC_CHECK)
+#undef GL_PROC_CHECK
+}
+
+
+/* Returns shader ID or 0 on error. */
+static inline GLuint
+gl_shader_compile(const GLenum type, const char *src) {
+	GLuint shader;
+	GLint status = GL_FALSE;
+	const char *srcs[3];
+	char log[1024];
+
+	/* GLSL 1.20 + rectangle textures, GL 2.1 context, or GLSL 3.30
+	 * for core profile.
+	 * VS_IN / VS_OUT / FS_IN are storage qualifiers of vertex
+	 * attributes and varyings, FRAG_COLOR is output: shaders using
+	 * them and texture2D*() do not depend on GLSL version. */
+	if (GL_CAPS(CORE)) {
+		srcs[0] = "#version 330 core\n"
+		    "#define VS_IN in\n"
+		    "#define VS_OUT out\n"
+		    "#define FS_IN in\n"
+		    "#define texture2D texture\n"
+		    "#define texture2DRect texture\n";
+		srcs[1] = ((GL_VERTEX_SHADER == type) ? "" :
+		    "out vec4 frag_color;\n"
+		    "#define FRAG_COLOR frag_color\n");
+	} else {
+		srcs[0] = "#version 120\n"
+		    "#extension GL_ARB_texture_rectangle : enable\n"
+		    "#define VS_IN attribute\n"
+		    "#define VS_OUT varying\n"
+		    "#define FS_IN varying\n";
+		srcs[1] = ((GL_VERTEX_SHADER == type) ?
+		    "" : "#define FRAG_COLOR gl_FragColor\n");
+	}
+	srcs[2] = src;
+	shader = glCreateShader(type);
+	if (0 == shader)
+		return (0);
+	glShaderSource(shader, 3, srcs, NULL);
+	glCompileShader(shader);
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (GL_TRUE != status) {
+		glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+		fprintf(stderr, "Shader compile failed: %s\n", log);
+		glDeleteShader(shader);
+		return (0);
+	}
+
+	return (shader);
+}
+
+/* vs_src may be NULL: fixed function vertex processing is used, not
+ * for core profile.
+ * attrs: NULL or NULL terminated vertex attributes names, bound to
+ * locations 0, 1, ... in order.
+ * Returns program ID or 0 on error. */
+static inline GLuint
+gl_program_create(const char *vs_src, const char *fs_src,
+    const char **attrs) {
+	GLuint prog, i, vs = 0, fs;
+	GLint status = GL_FALSE;
+	char log[1024];
+
+	if (NULL != vs_src) {
+		vs = gl_shader_compile(GL_VERTEX_SHADER, vs_src);
+		if (0 == vs)
+			return (0);
+	}
+	fs = gl_shader_compile(GL_FRAGMENT_SHADER, fs_src);
+	if (0 == fs) {
+		glDeleteShader(vs);
+		return (0);
+	}
+	prog = glCreateProgram();
+	if (0 != prog) {
+		if (0 != vs) {
+			glAttachShader(prog, vs);
+		}
+		glAttachShader(prog, fs);
+		for (i = 0; NULL != attrs && NULL != attrs[i]; i ++) {
+			glBindAttribLocation(prog, i, attrs[i]);
+		}
+		glLinkProgram(prog);
+		glGetProgramiv(prog, GL_LINK_STATUS, &status);
+		if (GL_TRUE != status) {
+			glGetProgramInfoLog(prog, sizeof(log), NULL, log);
+			fprintf(stderr, "Program link failed: %s\n", log);
+			glDeleteProgram(prog);
+			prog = 0;
+		}
+	}
+	/* Shaders are freed with program. */
+	glDeleteShader(vs);
+	glDeleteShader(fs);
+
+	return (prog);
+}
+
+/* Same matrix as gluPerspective() multiplies by, column major. */
+static inline void
+gl_mat4_perspective(GLfloat *m, const double fovy, const double aspect,
+    const double z_near, const double z_far) {
+	double f;
+
+	f = (1.0 / tan(((fovy * M_PI) / 360.0)));
+	memset(m, 0x00, (sizeof(GLfloat) * 16));
+	m[0] = (GLfloat)(f / aspect);
+	m[5] = (GLfloat)f;
+	m[10] = (GLfloat)((z_far + z_near) / (z_near - z_far));
+	m[11] = -1.0f;
+	m[14] = (GLfloat)((2.0 * z_far * z_near) / (z_near - z_far));
+}
+
+
+#endif /* GLUTILS_H */
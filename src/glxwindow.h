@@ -39,6 +39,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <stdint.h>
+#include <string.h>
 #include <errno.h>
 
 #include <X11/X.h>
@@ -68,6 +69,9 @@ typedef struct x_mouse_curs_pos_s {
 #define GLX_WND_REDRAW_F_DESTROY	(((uint32_t)1) << 1)
 #define GLX_WND_REDRAW_F_RESIZE		(((uint32_t)1) << 2)
 
+/* glx_wnd_create() flags. */
+#define GLX_WND_F_GL_LEGACY	(((uint32_t)1) << 0) /* No core profile. */
+
 typedef struct gl_x_window_s *glx_wnd_p;
 typedef void (*glx_wnd_redraw_cb)(glx_wnd_p glx_wnd, const uint32_t flags,
     const wnd_state_p ws, const mcur_pos_p mcur_pos, void *udata);
@@ -91,10 +95,51 @@ typedef struct gl_x_window_s {
 
 	wnd_state_t		ws;
 	mcur_pos_t		mcur_pos;
+	uint32_t		redraw_flags;	/* For next frame. */
+	int			redraw_pending;	/* Events require frame. */
 } glx_wnd_t;
 
 
 static PFNGLXCREATECONTEXTATTRIBSARBPROC glXCreateContextAttribs = NULL;
+static volatile int glx_wnd_ctx_error = 0;
+
+
+/* Context creation failure is reported by X error: default handler
+ * exits. */
+static int
+glx_wnd_ctx_error_handler(Display *display, XErrorEvent *event) {
+
+	(void)display;
+	(void)event;
+	glx_wnd_ctx_error = 1;
+
+	return (0);
+}
+
+/* Returns OpenGL 3.3 core profile context or NULL. */
+static inline GLXContext
+glx_wnd_ctx_core_create(Display *display, GLXFBConfig fbc) {
+	GLXContext glc;
+	int (*old_handler)(Display*, XErrorEvent*);
+	GLint attr_core[] = {
+		GLX_CONTEXT_MAJOR_VERSION_ARB, 3,
+		GLX_CONTEXT_MINOR_VERSION_ARB, 3,
+		GLX_CONTEXT_PROFILE_MASK_ARB, GLX_CONTEXT_CORE_PROFILE_BIT_ARB,
+		None
+	};
+
+	glx_wnd_ctx_error = 0;
+	old_handler = XSetErrorHandler(glx_wnd_ctx_error_handler);
+	glc = glXCreateContextAttribs(display, fbc, 0, True, attr_core);
+	XSync(display, False);
+	XSetErrorHandler(old_handler);
+	if (0 != glx_wnd_ctx_error && NULL != glc) {
+		glXDestroyContext(display, glc);
+		glc = NULL;
+	}
+
+	return (glc);
+}
 
 
 
@@ -155,10 +200,12 @@ glx_wnd_destroy(glx_wnd_p glx_wnd) {
 	memset(glx_wnd, 0x00, sizeof(glx_wnd_t));
 }
 
+/* Creates window with OpenGL 3.3 core profile context, if available and
+ * GLX_WND_F_GL_LEGACY is not set in flags, 2.1 context otherwise. */
 static inline int
 glx_wnd_create(uint32_t width, uint32_t height, const char *caption, 
-    glx_wnd_redraw_cb redraw_cb, glx_wnd_events_cb events_cb, void *udata,
-    glx_wnd_p glx_wnd) {
+    const uint32_t flags, glx_wnd_redraw_cb redraw_cb,
+    glx_wnd_events_cb events_cb, void *udata, glx_wnd_p glx_wnd) {
 	int error;
 	int glmaj, glmin;
 	int i, fbc_cnt, smpl_buf, smpl_cnt, bidx, bsmpl_cnt;
@@ -263,8 +310,15 @@ legacy_init:
 		}
 		glx_wnd->vi = glXGetVisualFromFBConfig(glx_wnd->display,
 		    fbc[bidx]);
-		glx_wnd->glc = glXCreateContextAttribs(glx_wnd->display,
-		    fbc[bidx], 0, True, attr_modern);
+		if (0 == (GLX_WND_F_GL_LEGACY & flags)) {
+			glx_wnd->glc = glx_wnd_ctx_core_create(
+			    glx_wnd->display, fbc[bidx]);
+		}
+		if (NULL == glx_wnd->glc) {
+			glx_wnd->glc = glXCreateContextAttribs(
+			    glx_wnd->display, fbc[bidx], 0, True,
+			    attr_modern);
+		}
 		XFree(fbc);
 	}
 	if (NULL == glx_wnd->vi) {
@@ -282,8 +336,10 @@ legacy_init:
 		fprintf(stderr, "Cannot create colormap.\n");
 		goto err_out;
 	}
+	/* Pointer position is tracked by motion events, frames need no
+	 * round trips to server. */
 	glx_wnd->swa.event_mask = (ExposureMask | KeyPressMask |
-	    StructureNotifyMask | ButtonPressMask);
+	    StructureNotifyMask | ButtonPressMask | PointerMotionMask);
 
 	glx_wnd->window = XCreateWindow(
 	    glx_wnd->display,
@@ -351,13 +407,13 @@ err_out:
 }
 
 
-/* Updating window events, running callbacks.
+/* Updating window events, running callbacks: handles all queued events,
+ * then draws one frame if redraw is set or events require it: window
+ * exposes and resizes are coalesced.
  * Returns 0 on success. */
 static inline int
-glx_wnd_update_window(glx_wnd_p glx_wnd) {
+glx_wnd_update_window(glx_wnd_p glx_wnd, const int redraw) {
 	XEvent event;
-	Window returnedWindow;
-	uint32_t mask;
 
 	if (NULL == glx_wnd ||
 	    NULL == glx_wnd->display ||
@@ -366,66 +422,144 @@ glx_wnd_update_window(glx_wnd_p glx_wnd) {
 		return (EINVAL);
 
 	/* Handle the events in the queue. */
-	if (XPending(glx_wnd->display) <= 0) {
-		/* Simple redraw GL window. */
-		/* Getting mouse cursor position. */
-		XQueryPointer(glx_wnd->display, glx_wnd->window,
-		    &returnedWindow, &returnedWindow,
-		    &glx_wnd->mcur_pos.root_x, &glx_wnd->mcur_pos.root_y,
-		    &glx_wnd->mcur_pos.win_x, &glx_wnd->mcur_pos.win_y,
-		    &mask);
-		glx_wnd->redraw_cb(glx_wnd, 0, &glx_wnd->ws,
-		    &glx_wnd->mcur_pos, glx_wnd->udata);
-		glXSwapBuffers(glx_wnd->display, glx_wnd->window);
-		return (0);
-	}
-
-	XNextEvent(glx_wnd->display, &event);
-	if (glx_wnd->events_cb) {
-		glx_wnd->events_cb(glx_wnd, &event, glx_wnd->udata);
-	}
+	while (0 < XPending(glx_wnd->display)) {
+		XNextEvent(glx_wnd->display, &event);
+		if (glx_wnd->events_cb) {
+			glx_wnd->events_cb(glx_wnd, &event, glx_wnd->udata);
+		}
 
-	switch (event.type) {
-	case Expose:
-		if (event.xexpose.count != 0)
+		switch (event.type) {
+		case Expose:
+			if (event.xexpose.count != 0)
+				break;
+			glx_wnd->redraw_pending = 1;
 			break;
-		glx_wnd->redraw_cb(glx_wnd, 0, &glx_wnd->ws,
-		    &glx_wnd->mcur_pos, glx_wnd->udata);
-		glXSwapBuffers(glx_wnd->display, glx_wnd->window);
-		break;
-	case ConfigureNotify:
-		/* Set resize flag only if window size was changed. */
-		if (((uint32_t)event.xconfigure.width != glx_wnd->ws.width) || 
-		    ((uint32_t)event.xconfigure.height != glx_wnd->ws.height)) {
+		case ConfigureNotify:
+			/* Set resize flag only if window size was changed. */
+			if ((uint32_t)event.xconfigure.width ==
+			    glx_wnd->ws.width &&
+			    (uint32_t)event.xconfigure.height ==
+			    glx_wnd->ws.height)
+				break;
 			glx_wnd->ws.width = (uint32_t)event.xconfigure.width;
 			glx_wnd->ws.height = (uint32_t)event.xconfigure.height;
-			glx_wnd->redraw_cb(glx_wnd, GLX_WND_REDRAW_F_RESIZE,
-			    &glx_wnd->ws, &glx_wnd->mcur_pos, glx_wnd->udata);
-			glXSwapBuffers(glx_wnd->display, glx_wnd->window);
-		}
-		break;
-	case ClientMessage:
-		if ((Atom)event.xclient.data.l[0] == glx_wnd->wm_delete) {
-			glx_wnd_destroy(glx_wnd);
-			return (-1);
-		}
-	case ButtonPress:
-	case ButtonRelease:
-	case KeyRelease:
-		break;
-	case KeyPress:
-		if (glx_wnd->events_cb)
+			glx_wnd->redraw_flags |= GLX_WND_REDRAW_F_RESIZE;
+			glx_wnd->redraw_pending = 1;
+			break;
+		case MotionNotify:
+			glx_wnd->mcur_pos.root_x = event.xmotion.x_root;
+			glx_wnd->mcur_pos.root_y = event.xmotion.y_root;
+			glx_wnd->mcur_pos.win_x = event.xmotion.x;
+			glx_wnd->mcur_pos.win_y = event.xmotion.y;
+			break;
+		case ClientMessage:
+			if ((Atom)event.xclient.data.l[0] ==
+			    glx_wnd->wm_delete) {
+				glx_wnd_destroy(glx_wnd);
+				return (-1);
+			}
+		case ButtonPress:
+		case ButtonRelease:
+		case KeyRelease:
+			break;
+		case KeyPress:
+			if (glx_wnd->events_cb)
+				break;
+			if (XLookupKeysym(&event.xkey, 0) == XK_Escape) {
+				glx_wnd_destroy(glx_wnd);
+				return (-1);
+			}
 			break;
-		if (XLookupKeysym(&event.xkey, 0) == XK_Escape) {
-			glx_wnd_destroy(glx_wnd);
-			return (-1);
 		}
-		break;
+	}
+
+	if (0 == redraw && 0 == glx_wnd->redraw_pending)
+		return (0);
+	glx_wnd->redraw_cb(glx_wnd, glx_wnd->redraw_flags, &glx_wnd->ws,
+	    &glx_wnd->mcur_pos, glx_wnd->udata);
+	glXSwapBuffers(glx_wnd->display, glx_wnd->window);
+	glx_wnd->redraw_flags = 0;
+	glx_wnd->redraw_pending = 0;
+
+	return (0);
+}
+
+
+/* Returns number of events queued, they are handled by next
+ * glx_wnd_update_window(). Output buffer is flushed. */
+static inline int
+glx_wnd_pending(glx_wnd_p glx_wnd) {
+
+	if (NULL == glx_wnd || NULL == glx_wnd->display)
+		return (0);
+
+	return (XPending(glx_wnd->display));
+}
+
+/* Returns X connection fd: it is readable when events may be queued
+ * by glx_wnd_pending(). */
+static inline int
+glx_wnd_fd(glx_wnd_p glx_wnd) {
+
+	if (NULL == glx_wnd || NULL == glx_wnd->display)
+		return (-1);
+
+	return (ConnectionNumber(glx_wnd->display));
+}
+
+
+static inline int
+glx_wnd_ext_supported(glx_wnd_p glx_wnd, const char *name) {
+	const char *exts, *pos;
+	size_t name_size;
+
+	exts = glXQueryExtensionsString(glx_wnd->display, glx_wnd->screen);
+	if (NULL == exts)
+		return (0);
+	name_size = strlen(name);
+	for (pos = exts; NULL != (pos = strstr(pos, name)); pos += name_size) {
+		if ((pos == exts || ' ' == pos[-1]) &&
+		    (' ' == pos[name_size] || 0 == pos[name_size]))
+			return (1);
 	}
 
 	return (0);
 }
 
+/* Sets number of vertical retraces glXSwapBuffers() waits for,
+ * 0 - do not wait.
+ * Returns 0 on success, ENOTSUP if no swap control extension. */
+static inline int
+glx_wnd_swap_interval_set(glx_wnd_p glx_wnd, const int interval) {
+	PFNGLXSWAPINTERVALEXTPROC swap_interval_ext;
+	PFNGLXSWAPINTERVALMESAPROC swap_interval_mesa;
+
+	if (NULL == glx_wnd ||
+	    NULL == glx_wnd->display ||
+	    0 == glx_wnd->window ||
+	    NULL == glx_wnd->glc ||
+	    0 > interval)
+		return (EINVAL);
+
+	if (glx_wnd_ext_supported(glx_wnd, "GLX_EXT_swap_control")) {
+		swap_interval_ext = (PFNGLXSWAPINTERVALEXTPROC)
+		    glXGetProcAddress((const GLubyte*)"glXSwapIntervalEXT");
+		if (NULL != swap_interval_ext) {
+			swap_interval_ext(glx_wnd->display, glx_wnd->window,
+			    interval);
+			return (0);
+		}
+	}
+	if (glx_wnd_ext_supported(glx_wnd, "GLX_MESA_swap_control")) {
+		swap_interval_mesa = (PFNGLXSWAPINTERVALMESAPROC)
+		    glXGetProcAddress((const GLubyte*)"glXSwapIntervalMESA");
+		if (NULL != swap_interval_mesa &&
+		    0 == swap_interval_mesa((unsigned int)interval))
+			return (0);
+	}
+
+	return (ENOTSUP);
+}
 
 static inline int
 glx_wnd_hide_cursor(glx_wnd_p glx_wnd) {
@@ -0,0 +1,146 @@
+/*
+ *  Copyright (c) 2020-2024 Rozhuk Ivan <rozhuk.im@gmail.com>
+ *  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * File:   glyphbake.c
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ * Build time tool: rasterizes digits of font and writes C header with
+ * glyph bitmaps, metrics and SDF atlas, so program does not need font
+ * file and FreeType at runtime.
+ */
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include "glyphs.h"
+#include "sdfbake.h"
+
+
+static void
+write_bytes(FILE *out, const char *name, const uint8_t *buf,
+    const size_t size) {
+	size_t i;
+
+	fprintf(out, "static const uint8_t %s[%zu] = {", name, size);
+	for (i = 0; i < size; i ++) {
+		fprintf(out, "%s0x%02x,", ((0 == (i % 16)) ? "\n\t" : " "),
+		    buf[i]);
+	}
+	fprintf(out, "\n};\n\n");
+}
+
+int
+main(int argc, char **argv) {
+	int error;
+	size_t i, off, size = 0, sdf_width, sdf_height;
+	glyph_bitmap_t glyphs[GLYPHS_COUNT];
+	face_sdf_glyph_t sdf_glyphs[GLYPHS_COUNT];
+	const uint8_t *bufs[GLYPHS_COUNT];
+	uint8_t *mem = NULL, *sdf;
+	FILE *out;
+
+	if (3 != argc) {
+		fprintf(stderr, "Usage: %s font.ttf out.h\n", argv[0]);
+		return (EINVAL);
+	}
+	error = glyphs_load(argv[1], glyphs, &mem);
+	if (0 != error) {
+		fprintf(stderr, "%s: load failed: %i.\n", argv[1], error);
+		return (error);
+	}
+	for (i = 0; i < GLYPHS_COUNT; i ++) {
+		sdf_glyphs[i].width = glyphs[i].width;
+		sdf_glyphs[i].height = glyphs[i].height;
+		sdf_glyphs[i].left = glyphs[i].left;
+		bufs[i] = glyphs[i].buf;
+		size += (glyphs[i].width * glyphs[i].height);
+	}
+	sdf = face_sdf_atlas_bake(bufs, sdf_glyphs, &sdf_width, &sdf_height);
+	if (NULL == sdf) {
+		free(mem);
+		return (ENOMEM);
+	}
+	out = fopen(argv[2], "w");
+	if (NULL == out) {
+		error = errno;
+		fprintf(stderr, "%s: open failed: %i.\n", argv[2], error);
+		free(sdf);
+		free(mem);
+		return (error);
+	}
+
+	fprintf(out, "/* Generated by glyphbake, do not edit. */\n\n"
+	    "#ifndef DIGITS_BAKED_H\n#define DIGITS_BAKED_H\n\n"
+	    "#if %i != GLYPHS_FONT_HEIGHT || %i != FACE_SDF_SCALE || "
+	    "%i != FACE_SDF_SPREAD\n"
+	    "#error \"Baked with other parameters.\"\n#endif\n\n",
+	    GLYPHS_FONT_HEIGHT, FACE_SDF_SCALE, FACE_SDF_SPREAD);
+	/* Glyphs bitmaps are one after another in mem. */
+	write_bytes(out, "digits_baked_bitmap", mem, size);
+	fprintf(out, "static const glyph_bitmap_t "
+	    "digits_baked_glyphs[%i] = {\n", GLYPHS_COUNT);
+	for (i = 0, off = 0; i < GLYPHS_COUNT; i ++) {
+		fprintf(out, "\t{ %"PRIu32", %"PRIu32", %"PRIi32", %"PRIi32", "
+		    "&digits_baked_bitmap[%zu] },\n",
+		    glyphs[i].width, glyphs[i].height, glyphs[i].top,
+		    glyphs[i].left, off);
+		off += (glyphs[i].width * glyphs[i].height);
+	}
+	fprintf(out, "};\n\n");
+
+	fprintf(out, "#define DIGITS_BAKED_SDF_WIDTH\t%zu\n"
+	    "#define DIGITS_BAKED_SDF_HEIGHT\t%zu\n\n",
+	    sdf_width, sdf_height);
+	write_bytes(out, "digits_baked_sdf", sdf, (sdf_width * sdf_height));
+	fprintf(out, "static const face_sdf_glyph_t "
+	    "digits_baked_sdf_glyphs[%i] = {\n", GLYPHS_COUNT);
+	for (i = 0; i < GLYPHS_COUNT; i ++) {
+		fprintf(out, "\t{ %"PRIu32", %"PRIu32", %"PRIi32", "
+		    "%"PRIu32", %"PRIu32" },\n",
+		    sdf_glyphs[i].width, sdf_glyphs[i].height,
+		    sdf_glyphs[i].left, sdf_glyphs[i].tex_x,
+		    sdf_glyphs[i].tex_y);
+	}
+	fprintf(out, "};\n\n#endif /* DIGITS_BAKED_H */\n");
+
+	error = ((0 != ferror(out)) ? EIO : 0);
+	if (0 != fclose(out) && 0 == error) {
+		error = errno;
+	}
+	free(sdf);
+	free(mem);
+	if (0 != error) {
+		fprintf(stderr, "%s: write failed: %i.\n", argv[2], error);
+		remove(argv[2]);
+	}
+
+	return (error);
+}
@@ -0,0 +1,122 @@
+/*
+ *  Copyright (c) 2020-2024 Rozhuk Ivan <rozhuk.im@gmail.com>
+ *  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * File:   glyphs.h
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ * Digits 0..9 rasterized by FreeType: used by glyphbake at build time
+ * and at runtime for custom font.
+ */
+
+#ifndef GLYPHS_H
+#define GLYPHS_H
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+
+#define GLYPHS_COUNT		10
+#define GLYPHS_FONT_HEIGHT	256
+
+typedef struct glyph_bitmap_s {
+	uint32_t	width;
+	uint32_t	height;
+	int32_t		top;
+	int32_t		left;
+	const uint8_t	*buf;		/* Coverage, pitch is width. */
+} glyph_bitmap_t, *glyph_bitmap_p;
+
+
+/* Rasterizes digits of font_name, GLYPHS_FONT_HEIGHT points at 96 dpi.
+ * glyphs buffers are in *mem, caller must free() it.
+ * Returns 0 on success. */
+static inline int
+glyphs_load(const char *font_name, glyph_bitmap_p glyphs, uint8_t **mem) {
+	int error = EINVAL;
+	FT_Library lib = NULL;
+	FT_Face font = NULL;
+	FT_GlyphSlot gliph;
+	size_t i, y, off, size = 0;
+	uint8_t *buf = NULL;
+
+	if (NULL == font_name || NULL == glyphs || NULL == mem)
+		return (EINVAL);
+	(*mem) = NULL;
+	if (0 != FT_Init_FreeType(&lib))
+		return (ENOTSUP);
+	if (0 != FT_New_Face(lib, font_name, 0, &font) ||
+	    0 != FT_Set_Char_Size(font, (GLYPHS_FONT_HEIGHT << 6),
+	    (GLYPHS_FONT_HEIGHT << 6), 96, 96))
+		goto err_out;
+	/* Metrics first: one buffer for all. */
+	gliph = font->glyph;
+	for (i = 0; i < GLYPHS_COUNT; i ++) {
+		if (0 != FT_Load_Char(font, ('0' + i), FT_LOAD_RENDER))
+			goto err_out;
+		glyphs[i].width = gliph->bitmap.width;
+		glyphs[i].height = gliph->bitmap.rows;
+		glyphs[i].top = gliph->bitmap_top;
+		glyphs[i].left = gliph->bitmap_left;
+		size += (glyphs[i].width * glyphs[i].height);
+	}
+	buf = malloc(MAX(size, 1));
+	if (NULL == buf) {
+		error = ENOMEM;
+		goto err_out;
+	}
+	for (i = 0, off = 0; i < GLYPHS_COUNT; i ++) {
+		if (0 != FT_Load_Char(font, ('0' + i), FT_LOAD_RENDER))
+			goto err_out;
+		for (y = 0; y < glyphs[i].height; y ++) {
+			memcpy(&buf[(off + (y * glyphs[i].width))],
+			    &gliph->bitmap.buffer[(y * (size_t)gliph->bitmap.pitch)],
+			    glyphs[i].width);
+		}
+		glyphs[i].buf = &buf[off];
+		off += (glyphs[i].width * glyphs[i].height);
+	}
+	(*mem) = buf;
+	buf = NULL;
+	error = 0;
+
+err_out:
+	free(buf);
+	FT_Done_Face(font);
+	FT_Done_FreeType(lib);
+
+	return (error);
+}
+
+
+#endif /* GLYPHS_H */
@@ -0,0 +1,149 @@
+/*
+ *  Copyright (c) 2020-2024 Rozhuk Ivan <rozhuk.im@gmail.com>
+ *  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * File:   prng.h
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ * Seedable, not cryptographic, PRNG: PRNG_LANES independent xoshiro128**
+ * generators stepped together, so compiler turns lanes loop into SIMD.
+ */
+
+#ifndef PRNG_H
+#define PRNG_H
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define PRNG_LANES		8
+
+typedef struct prng_s {
+	uint32_t	s[4][PRNG_LANES]; /* State: s[word][lane]. */
+	uint32_t	out[PRNG_LANES]; /* Not used output of last step. */
+	size_t		out_pos;
+} prng_t, *prng_p;
+
+
+/* Returns seed that differs from run to run. */
+static inline uint64_t
+prng_seed_random(void) {
+
+	return ((((uint64_t)arc4random()) << 32) | arc4random());
+}
+
+static inline uint64_t
+prng_splitmix64(uint64_t *x) {
+	uint64_t z;
+
+	z = ((*x) += 0x9e3779b97f4a7c15ull);
+	z = ((z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull);
+	z = ((z ^ (z >> 27)) * 0x94d049bb133111ebull);
+
+	return (z ^ (z >> 31));
+}
+
+static inline void
+prng_init(prng_p prng, uint64_t seed) {
+	size_t i, lane;
+	uint64_t v;
+
+	memset(prng, 0x00, sizeof(prng_t));
+	/* SplitMix64 expands seed, never gives all zero lane state. */
+	for (lane = 0; lane < PRNG_LANES; lane ++) {
+		for (i = 0; i < 4; i += 2) {
+			v = prng_splitmix64(&seed);
+			prng->s[i][lane] = (uint32_t)v;
+			prng->s[(i + 1)][lane] = (uint32_t)(v >> 32);
+		}
+	}
+	prng->out_pos = PRNG_LANES;
+}
+
+static inline uint32_t
+prng_rotl(const uint32_t x, const int k) {
+
+	return ((x << k) | (x >> (32 - k)));
+}
+
+/* Steps all lanes, one uint32_t from each to out. */
+static inline void
+prng_step(prng_p prng, uint32_t *out) {
+	size_t lane;
+	uint32_t t;
+
+	for (lane = 0; lane < PRNG_LANES; lane ++) {
+		out[lane] = (prng_rotl((prng->s[1][lane] * 5), 7) * 9);
+		t = (prng->s[1][lane] << 9);
+		prng->s[2][lane] ^= prng->s[0][lane];
+		prng->s[3][lane] ^= prng->s[1][lane];
+		prng->s[1][lane] ^= prng->s[2][lane];
+		prng->s[0][lane] ^= prng->s[3][lane];
+		prng->s[2][lane] ^= t;
+		prng->s[3][lane] = prng_rotl(prng->s[3][lane], 11);
+	}
+}
+
+/* Fills buf with random bytes. */
+static inline void
+prng_fill(prng_p prng, void *buf, const size_t size) {
+	size_t off;
+	uint32_t out[PRNG_LANES];
+
+	for (off = 0; (off + sizeof(out)) <= size; off += sizeof(out)) {
+		prng_step(prng, out);
+		memcpy(((uint8_t*)buf + off), out, sizeof(out));
+	}
+	if (off < size) {
+		prng_step(prng, out);
+		memcpy(((uint8_t*)buf + off), out, (size - off));
+	}
+}
+
+static inline uint32_t
+prng_u32(prng_p prng) {
+
+	if (PRNG_LANES <= prng->out_pos) {
+		prng_step(prng, prng->out);
+		prng->out_pos = 0;
+	}
+
+	return (prng->out[prng->out_pos ++]);
+}
+
+/* Returns value in [0, max_val]. */
+static inline uint32_t
+prng_range(prng_p prng, const uint32_t max_val) {
+
+	return ((uint32_t)((((uint64_t)prng_u32(prng)) *
+	    (((uint64_t)max_val) + 1)) >> 32));
+}
+
+
+#endif /* PRNG_H */
@@ -0,0 +1,162 @@
+/*
+ *  Copyright (c) 2020-2024 Rozhuk Ivan <rozhuk.im@gmail.com>
+ *  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * File:   sdfbake.h
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ * Signed distance field atlas of digit glyphs, no GL here: same code
+ * bakes atlas at build time and at runtime for custom font.
+ */
+
+#ifndef SDFBAKE_H
+#define SDFBAKE_H
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+
+#define FACE_SDF_GLYPHS		10
+/* Source bitmap pixels per atlas texel. */
+#define FACE_SDF_SCALE		4
+/* Distance range, source pixels: atlas texel 0 - SPREAD outside edge,
+ * 255 - SPREAD inside. */
+#define FACE_SDF_SPREAD		16
+/* Atlas texels around glyph. */
+#define FACE_SDF_PAD		(FACE_SDF_SPREAD / FACE_SDF_SCALE)
+
+typedef struct face_sdf_glyph_s {
+	uint32_t	width;		/* Source bitmap size. */
+	uint32_t	height;
+	int32_t		left;
+	uint32_t	tex_x;		/* Glyph field in atlas, with pad. */
+	uint32_t	tex_y;
+} face_sdf_glyph_t, *face_sdf_glyph_p;
+
+
+/* Returns atlas texels for size source pixels. */
+static inline size_t
+face_sdf_dim(const size_t size) {
+
+	return (((size + FACE_SDF_SCALE - 1) / FACE_SDF_SCALE) +
+	    (2 * FACE_SDF_PAD));
+}
+
+static inline int
+face_sdf_src_in(const uint8_t *src, const size_t src_w, const size_t src_h,
+    const size_t src_pitch, const ssize_t x, const ssize_t y) {
+
+	if (0 > x || 0 > y || (size_t)x >= src_w || (size_t)y >= src_h)
+		return (0);
+
+	return (128 <= src[(x + (y * (ssize_t)src_pitch))]);
+}
+
+/* Bakes signed distance field of src_w x src_h coverage bitmap to dst:
+ * face_sdf_dim(src_w) x face_sdf_dim(src_h) texels, 128 is edge. */
+static inline void
+face_sdf_bake(const uint8_t *src, const size_t src_w, const size_t src_h,
+    const size_t src_pitch, uint8_t *dst, const size_t dst_pitch) {
+	const ssize_t spread = FACE_SDF_SPREAD;
+	const size_t dst_w = face_sdf_dim(src_w), dst_h = face_sdf_dim(src_h);
+	size_t tx, ty;
+	ssize_t x, y, sx, sy;
+	int inside;
+	float cx, cy, dx, dy, dist, best;
+
+	for (ty = 0; ty < dst_h; ty ++) {
+		for (tx = 0; tx < dst_w; tx ++) {
+			/* Texel center in source pixels. */
+			cx = ((((float)tx - FACE_SDF_PAD) + 0.5f) *
+			    FACE_SDF_SCALE);
+			cy = ((((float)ty - FACE_SDF_PAD) + 0.5f) *
+			    FACE_SDF_SCALE);
+			sx = (ssize_t)floorf(cx);
+			sy = (ssize_t)floorf(cy);
+			inside = face_sdf_src_in(src, src_w, src_h, src_pitch,
+			    sx, sy);
+			/* Nearest pixel on other side of edge. */
+			best = (float)(spread * spread);
+			for (y = (sy - spread); y <= (sy + spread); y ++) {
+				dy = (((float)y + 0.5f) - cy);
+				if ((dy * dy) >= best)
+					continue;
+				for (x = (sx - spread); x <= (sx + spread);
+				    x ++) {
+					if (inside == face_sdf_src_in(src,
+					    src_w, src_h, src_pitch, x, y))
+						continue;
+					dx = (((float)x + 0.5f) - cx);
+					best = MIN(best, ((dx * dx) + (dy * dy)));
+				}
+			}
+			/* Edge is half pixel before pixel center. */
+			dist = (sqrtf(best) - 0.5f);
+			if (0 == inside) {
+				dist = -dist;
+			}
+			dist = ((0.5f + ((0.5f * dist) / (float)spread)) * 255.0f);
+			dst[(tx + (ty * dst_pitch))] =
+			    (uint8_t)MIN(MAX((dist + 0.5f), 0.0f), 255.0f);
+		}
+	}
+}
+
+/* Places glyphs in one row and bakes their fields, glyphs width, height
+ * and left must be set, tex_x and tex_y are set here.
+ * bufs - coverage bitmaps of glyphs, pitch is width.
+ * Returns malloc()ed atlas of *width x *height texels or NULL. */
+static inline uint8_t *
+face_sdf_atlas_bake(const uint8_t * const *bufs, face_sdf_glyph_p glyphs,
+    size_t *width, size_t *height) {
+	size_t i;
+	uint8_t *atlas;
+
+	(*width) = 0;
+	(*height) = 0;
+	for (i = 0; i < FACE_SDF_GLYPHS; i ++) {
+		glyphs[i].tex_x = (uint32_t)(*width);
+		glyphs[i].tex_y = 0;
+		(*width) += face_sdf_dim(glyphs[i].width);
+		(*height) = MAX((*height), face_sdf_dim(glyphs[i].height));
+	}
+	atlas = calloc(1, ((*width) * (*height)));
+	if (NULL == atlas)
+		return (NULL);
+	for (i = 0; i < FACE_SDF_GLYPHS; i ++) {
+		face_sdf_bake(bufs[i], glyphs[i].width, glyphs[i].height,
+		    glyphs[i].width, &atlas[glyphs[i].tex_x], (*width));
+	}
+
+	return (atlas);
+}
+
+
+#endif /* SDFBAKE_H */
@@ -0,0 +1,341 @@
+/*
+ *  Copyright (c) 2020-2024 Rozhuk Ivan <rozhuk.im@gmail.com>
+ *  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * File:   spheremesh.h
+ * Author: Rozhuk Ivan <rozhuk.im@gmail.com>
+ *
+ * Sphere mesh tessellated once into static vertex and index buffers, all
+ * spheres are drawn by one instanced call.
+ * Without instancing support spheres are drawn one by one, per sphere
+ * position is set as constant vertex attribute; without GLSL - by fixed
+ * function pipeline with current matrices and lighting.
+ */
+
+#ifndef SPHEREMESH_H
+#define SPHEREMESH_H
+
+
+#include <sys/param.h>
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#include "glutils.h"
+#include "glstate.h"
+
+
+#define SPHERE_MESH_DETAIL_MIN	4
+#define SPHERE_MESH_DETAIL_MAX	128 /* Indices are GLushort. */
+#define SPHERE_MESH_DETAIL_DEF	16
+
+/* Vertex attributes locations. */
+#define SPHERE_MESH_ATTR_POS	0 /* Unit sphere: position is normal. */
+#define SPHERE_MESH_ATTR_INST_POS 1
+
+static const char *sphere_mesh_attrs[] = {
+	"pos", "inst_pos", NULL
+};
+
+typedef struct sphere_mesh_s {
+	GLuint		prog;		/* 0: fixed function draw. */
+	GLint		proj_loc;
+	GLint		light_loc;
+	GLint		color_loc;
+	GLint		radius_loc;
+	GLuint		vao;		/* 0: no VAO support. */
+	GLuint		vbo;
+	GLuint		ibo;
+	GLuint		inst_vbo;	/* 0: no instancing support. */
+	GLsizei		indices;
+	size_t		inst_max;
+} sphere_mesh_t, *sphere_mesh_p;
+
+
+/* Same lighting as fixed function one with single directional light and
+ * color material. */
+static const char *sphere_mesh_vs =
+	"uniform mat4 proj;\n"
+	"uniform vec4 light;\n" /* Eye space direction, ambient sum. */
+	"uniform vec4 color;\n"
+	"uniform float radius;\n"
+	"VS_IN vec3 pos;\n"
+	"VS_IN vec3 inst_pos;\n"
+	"VS_OUT vec4 face_color;\n"
+	"void main() {\n"
+	"	float l = (light.w + max(dot(pos, light.xyz), 0.0));\n"
+	"	gl_Position = (proj *\n"
+	"	    vec4(((pos * radius) + inst_pos), 1.0));\n"
+	"	face_color = vec4(min((color.rgb * l), 1.0), color.a);\n"
+	"}\n";
+
+static const char *sphere_mesh_fs =
+	"FS_IN vec4 face_color;\n"
+	"void main() {\n"
+	"	FRAG_COLOR = face_color;\n"
+	"}\n";
+
+
+/* Binds buffers and sets attributes pointers: VAO content. */
+static inline void
+sphere_mesh_attrs_setup(sphere_mesh_p sm) {
+
+	glBindBuffer(GL_ARRAY_BUFFER, sm->vbo);
+	glEnableVertexAttribArray(SPHERE_MESH_ATTR_POS);
+	glVertexAttribPointer(SPHERE_MESH_ATTR_POS, 3, GL_FLOAT, GL_FALSE,
+	    0, NULL);
+	if (0 != sm->inst_vbo) {
+		glBindBuffer(GL_ARRAY_BUFFER, sm->inst_vbo);
+		glEnableVertexAttribArray(SPHERE_MESH_ATTR_INST_POS);
+		glVertexAttribPointer(SPHERE_MESH_ATTR_INST_POS, 3, GL_FLOAT,
+		    GL_FALSE, 0, NULL);
+		glVertexAttribDivisor(SPHERE_MESH_ATTR_INST_POS, 1);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sm->ibo);
+}
+
+static inline void
+sphere_mesh_attrs_cleanup(sphere_mesh_p sm) {
+
+	glDisableVertexAttribArray(SPHERE_MESH_ATTR_POS);
+	if (0 != sm->inst_vbo) {
+		glVertexAttribDivisor(SPHERE_MESH_ATTR_INST_POS, 0);
+		glDisableVertexAttribArray(SPHERE_MESH_ATTR_INST_POS);
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+
+static inline void
+sphere_mesh_destroy(sphere_mesh_p sm) {
+
+	if (NULL == sm)
+		return;
+	if (0 != sm->prog) {
+		glDeleteProgram(sm->prog);
+	}
+	if (0 != sm->vao) {
+		glDeleteVertexArrays(1, &sm->vao);
+	}
+	glDeleteBuffers(1, &sm->vbo);
+	glDeleteBuffers(1, &sm->ibo);
+	glDeleteBuffers(1, &sm->inst_vbo);
+	memset(sm, 0x00, sizeof(sphere_mesh_t));
+}
+
+/* Tessellates unit sphere as gluSphere() does: slices around z axis,
+ * stacks along z axis, detail is slices and stacks count.
+ * inst_max - max spheres drawn by one call.
+ * gl_caps_init() must be called before.
+ * Returns 0 on success. */
+static inline int
+sphere_mesh_init(sphere_mesh_p sm, const size_t detail,
+    const size_t inst_max) {
+	size_t i, j, off, row = (detail + 1);
+	double theta, phi;
+	GLfloat *vertices;
+	GLushort *indices;
+
+	if (NULL == sm || SPHERE_MESH_DETAIL_MIN > detail ||
+	    SPHERE_MESH_DETAIL_MAX < detail || 0 == inst_max)
+		return (EINVAL);
+	memset(sm, 0x00, sizeof(sphere_mesh_t));
+	sm->inst_max = inst_max;
+	sm->indices = (GLsizei)(detail * detail * 6);
+	vertices = malloc((sizeof(GLfloat) * 3 * row * row));
+	indices = malloc((sizeof(GLushort) * (size_t)sm->indices));
+	if (NULL == vertices || NULL == indices) {
+		free(vertices);
+		free(indices);
+		return (ENOMEM);
+	}
+	/* Row per stack from +z pole, seam vertex is duplicated. */
+	for (i = 0; i < row; i ++) {
+		theta = ((M_PI * (double)i) / (double)detail);
+		for (j = 0; j < row; j ++) {
+			phi = ((2.0 * M_PI * (double)j) / (double)detail);
+			off = (((i * row) + j) * 3);
+			vertices[(off + 0)] = (GLfloat)(sin(phi) * sin(theta));
+			vertices[(off + 1)] = (GLfloat)(cos(phi) * sin(theta));
+			vertices[(off + 2)] = (GLfloat)cos(theta);
+		}
+	}
+	/* Quad between stacks: 2 triangles. */
+	for (i = 0, off = 0; i < detail; i ++) {
+		for (j = 0; j < detail; j ++) {
+			indices[(off ++)] = (GLushort)((i * row) + j);
+			indices[(off ++)] = (GLushort)(((i + 1) * row) + j);
+			indices[(off ++)] = (GLushort)(((i + 1) * row) + j + 1);
+			indices[(off ++)] = (GLushort)((i * row) + j);
+			indices[(off ++)] = (GLushort)(((i + 1) * row) + j + 1);
+			indices[(off ++)] = (GLushort)((i * row) + j + 1);
+		}
+	}
+	glGenBuffers(1, &sm->vbo);
+	glGenBuffers(1, &sm->ibo);
+	if (0 != sm->vbo && 0 != sm->ibo) {
+		glBindBuffer(GL_ARRAY_BUFFER, sm->vbo);
+		glBufferData(GL_ARRAY_BUFFER,
+		    (GLsizeiptr)(sizeof(GLfloat) * 3 * row * row), vertices,
+		    GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sm->ibo);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+		    (GLsizeiptr)(sizeof(GLushort) * (size_t)sm->indices),
+		    indices, GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+	free(vertices);
+	free(indices);
+	if (0 == sm->vbo || 0 == sm->ibo) {
+		sphere_mesh_destroy(sm);
+		return (ENOMEM);
+	}
+
+	if (!GL_CAPS(GLSL))
+		return (0); /* Fixed function draw. */
+	sm->prog = gl_program_create(sphere_mesh_vs, sphere_mesh_fs,
+	    sphere_mesh_attrs);
+	if (0 == sm->prog) {
+		if (!GL_CAPS(CORE))
+			return (0); /* Fixed function draw. */
+		sphere_mesh_destroy(sm);
+		return (EOPNOTSUPP);
+	}
+	sm->proj_loc = glGetUniformLocation(sm->prog, "proj");
+	sm->light_loc = glGetUniformLocation(sm->prog, "light");
+	sm->color_loc = glGetUniformLocation(sm->prog, "color");
+	sm->radius_loc = glGetUniformLocation(sm->prog, "radius");
+	if (GL_CAPS(INSTANCED)) {
+		glGenBuffers(1, &sm->inst_vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, sm->inst_vbo);
+		glBufferData(GL_ARRAY_BUFFER,
+		    (GLsizeiptr)(sizeof(GLfloat) * 3 * inst_max), NULL,
+		    GL_STREAM_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+	if (GL_CAPS(VAO)) {
+		glGenVertexArrays(1, &sm->vao);
+		glBindVertexArray(sm->vao);
+		sphere_mesh_attrs_setup(sm);
+		glBindVertexArray(0);
+		/* Element buffer binding is VAO state. */
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+
+	return (0);
+}
+
+/* Fixed function: current matrices, lighting and material are used. */
+static inline void
+sphere_mesh_draw_ff(sphere_mesh_p sm, const GLfloat *color,
+    const GLfloat radius, const GLfloat *inst, const size_t count) {
+	size_t i;
+
+	glColor4fv(color);
+	glBindBuffer(GL_ARRAY_BUFFER, sm->vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sm->ibo);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, NULL);
+	glNormalPointer(GL_FLOAT, 0, NULL);
+	for (i = 0; i < count; i ++) {
+		glPushMatrix();
+		glTranslatef(inst[((i * 3) + 0)], inst[((i * 3) + 1)],
+		    inst[((i * 3) + 2)]);
+		glScalef(radius, radius, radius);
+		glDrawElements(GL_TRIANGLES, sm->indices, GL_UNSIGNED_SHORT,
+		    NULL);
+		glPopMatrix();
+	}
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/* Draws count spheres of radius at inst: x, y, z per sphere.
+ * proj - column major projection matrix, view is identity; light - eye
+ * space direction to light and ambient lighting sum. */
+static inline void
+sphere_mesh_draw(sphere_mesh_p sm, const GLfloat *proj, const GLfloat *light,
+    const GLfloat *color, const GLfloat radius, const GLfloat *inst,
+    const size_t count) {
+	size_t i;
+
+	if (0 == count || sm->inst_max < count)
+		return;
+	if (0 == sm->prog) {
+		sphere_mesh_draw_ff(sm, color, radius, inst, count);
+		return;
+	}
+	if (0 != sm->inst_vbo) {
+		/* Orphan old content: no wait for previous frame draw. */
+		glBindBuffer(GL_ARRAY_BUFFER, sm->inst_vbo);
+		glBufferData(GL_ARRAY_BUFFER,
+		    (GLsizeiptr)(sizeof(GLfloat) * 3 * sm->inst_max), NULL,
+		    GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0,
+		    (GLsizeiptr)(sizeof(GLfloat) * 3 * count), inst);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+	gl_state_use_program(sm->prog);
+	glUniformMatrix4fv(sm->proj_loc, 1, GL_FALSE, proj);
+	glUniform4fv(sm->light_loc, 1, light);
+	glUniform4fv(sm->color_loc, 1, color);
+	glUniform1f(sm->radius_loc, radius);
+	if (0 != sm->vao) {
+		glBindVertexArray(sm->vao);
+	} else {
+		sphere_mesh_attrs_setup(sm);
+	}
+	if (0 != sm->inst_vbo) {
+		glDrawElementsInstanced(GL_TRIANGLES, sm->indices,
+		    GL_UNSIGNED_SHORT, NULL, (GLsizei)count);
+	} else {
+		for (i = 0; i < count; i ++) {
+			glVertexAttrib3fv(SPHERE_MESH_ATTR_INST_POS,
+			    &inst[(i * 3)]);
+			glDrawElements(GL_TRIANGLES, sm->indices,
+			    GL_UNSIGNED_SHORT, NULL);
+		}
+	}
+	if (0 != sm->vao) {
+		glBindVertexArray(0);
+	} else {
+		sphere_mesh_attrs_cleanup(sm);
+	}
+	gl_state_use_program(0);
+}
+
+
+#endif /* SPHEREMESH_H */